@@ -10,11 +10,83 @@
 #include <random>
 #include <array>
 #include <execution>
+#include <numeric>
+#include <algorithm>
+#include <string_view>
+#include <optional>
+#include <atomic>
+#include <compare>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <map>
+#include <bit>
+#include <numbers>
+#include <span>
 
+#if defined( _WIN32 )
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+extern char ** environ;
+#endif
 
-using Real = double;
+// the EGL library is loaded at runtime for offscreen rendering only, without its prototypes nor the native window types:
+#define EGL_EGL_PROTOTYPES 0
+#define EGL_NO_PLATFORM_SPECIFIC_TYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define LIGHTSHOT_X86
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#endif
+
+// instruction set extensions are enabled per function, the dispatch happens at runtime,
+// multiply-add contraction is disabled so that vector lanes stay bit-identical to the scalar code:
+#if defined( __clang__ )
+#define LIGHTSHOT_TARGET( _isa ) __attribute__(( target( _isa ) ))
+#elif defined( __GNUC__ )
+#define LIGHTSHOT_TARGET( _isa ) __attribute__(( target( _isa ), optimize( "fp-contract=off" ) ))
+#else
+#define LIGHTSHOT_TARGET( _isa )
+#endif
+
+// structures aligned to a cache line to keep threads off each other's lines are padded on purpose, MSVC warning about it (C4324):
+#if defined( _MSC_VER )
+#define LIGHTSHOT_PADDED_BEGIN __pragma( warning( push ) ) __pragma( warning( disable: 4324 ) )
+#define LIGHTSHOT_PADDED_END __pragma( warning( pop ) )
+#else
+#define LIGHTSHOT_PADDED_BEGIN
+#define LIGHTSHOT_PADDED_END
+#endif
+
+
+using Real = double; // geometry precision, the transport engine precision is a template parameter
+template< typename T > using Vector3 = std::array< T, 3 >;
 using Vector2D = std::array< Real, 2 >;
-using Vector3D = std::array< Real, 3 >;
+using Vector3D = Vector3< Real >;
 using Color = std::array< unsigned char, 3 >;
 
 struct Scene
@@ -29,37 +101,64 @@ struct Scene
     Real materialRetransmission;
     Real wavelengthDecayDistance;
     Vector3D wavelengthDecay;
+    unsigned depthSeed; // depths map generator
+    unsigned colorSeed; // plate colors generator
+};
+
+// depths of the grid cells, row after row:
+struct DepthsMap
+{
+    unsigned width;
+    unsigned height;
+    std::vector< int > depths;
+
+    int & operator ()( const unsigned _row, const unsigned _col ) { return depths[ static_cast< std::size_t >( _row ) * width + _col ]; }
+    int operator ()( const unsigned _row, const unsigned _col ) const { return depths[ static_cast< std::size_t >( _row ) * width + _col ]; }
 };
 
-using DepthsMap = std::vector< std::vector< int > >;
+// every row draws from its own stream, seeded by the generator seed and the row index, so that the rows are generated in parallel
+// to the very same scene whatever the thread count:
+inline static std::mt19937 RowGenerator( const unsigned _seed, const unsigned _row )
+{
+    std::seed_seq seeds{ _seed, _row };
+    return std::mt19937{ seeds };
+}
+
+// raised whenever the same seeds generate another scene, recorded along with the seeds (2: every row drawn from its own stream):
+inline static constexpr unsigned sceneGeneratorVersion{ 2 };
+
+inline static std::vector< unsigned > RowIndices( const unsigned _height )
+{
+    std::vector< unsigned > rows( _height );
+    std::iota( rows.begin(), rows.end(), 0 );
+    return rows;
+}
 
 DepthsMap GenerateDepthsMap( const Scene & _scene )
 {
-    auto rows{ _scene.height };
-    auto depth{ static_cast< int >( _scene.maxDepth ) };
-    //std::random_device rndDevice;
-    //std::mt19937 rnd{ rndDevice() }; // TODO
-    std::mt19937 rnd{ 4 };
-    std::uniform_int_distribution< int > rndDepthTrigger( 0, 100 );
-    auto rndDepthRate{ 100 - static_cast< int >( _scene.rndDepthRate ) };
-    std::uniform_int_distribution< int > rndDepth( -depth, depth );
-    DepthsMap depthsMap;
-    while( rows-- != 0 ) {
-        auto & colsMap{ depthsMap.emplace_back( std::vector< int >{} ) };
-        auto cols{ _scene.width };
-        while( cols-- != 0 )
-            colsMap.emplace_back( rndDepthTrigger( rnd ) >= rndDepthRate ? rndDepth( rnd ) : 0 );
-    }       
+    const auto depth{ static_cast< int >( _scene.maxDepth ) };
+    const auto rndDepthRate{ 100 - static_cast< int >( _scene.rndDepthRate ) };
+    DepthsMap depthsMap{ _scene.width, _scene.height, std::vector< int >( static_cast< std::size_t >( _scene.width ) * _scene.height ) };
+    const auto rows{ RowIndices( _scene.height ) };
+    std::for_each( std::execution::par, rows.begin(), rows.end(), [ & ]( const unsigned _row ) {
+        auto rnd{ RowGenerator( _scene.depthSeed, _row ) };
+        std::uniform_int_distribution< int > rndDepthTrigger( 0, 100 );
+        std::uniform_int_distribution< int > rndDepth( -depth, depth );
+        for( unsigned col{ 0 }; col < _scene.width; ++col )
+            depthsMap( _row, col ) = rndDepthTrigger( rnd ) >= rndDepthRate ? rndDepth( rnd ) : 0;
+    } );
     return depthsMap;
 }
 
 struct Plate;
 
+// the position stays in geometry precision as the occlusion test runs on it:
+template< typename T >
 struct Photon
 {
     Vector3D position;
-    Vector3D normal;
-    Vector3D color;
+    Vector3< T > normal;
+    Vector3< T > color;
 };
 
 struct Material
@@ -68,19 +167,162 @@ struct Material
     Real retransmission;
 };
 
+// corners of a plate, its texel ( x, y ) lying along the first edge then along the last one:
+using Quad = std::array< Vector3D, 4 >;
+
 struct Plate
 {
-    std::array< Vector3D, 4 > positions;
-    std::array< Vector2D, 4 > textures;
+    Quad positions;
     Vector3D normal;
     Material material;
-    std::vector< Photon > emitters;
-    std::vector< Vector3D > receivers;
-    std::vector< Color > colors;
 };
 
 using Plates = std::vector< Plate >;
 
+// plate corners alone, the compact array walked by the occlusion tests:
+using Quads = std::vector< Quad >;
+
+inline static Quads PlateQuads( const Plates & _plates )
+{
+    Quads quads( _plates.size() );
+    std::transform( _plates.begin(), _plates.end(), quads.begin(), []( const Plate & _plate ) { return _plate.positions; } );
+    return quads;
+}
+
+// structure of arrays, one entry per texel:
+template< typename T >
+struct Vector3Array
+{
+    std::vector< T > x;
+    std::vector< T > y;
+    std::vector< T > z;
+};
+
+// range of the entries of a structure of arrays:
+template< typename T >
+struct Vector3Span
+{
+    std::span< T > x;
+    std::span< T > y;
+    std::span< T > z;
+};
+
+// the per-texel arrays hold the texels of every plate, plate after plate, a plate starting at its offset: the first texel
+// of every plate then the texel total, so that a plate texel count is free to differ from the others:
+using AtlasOffsets = std::vector< std::size_t >;
+
+inline static AtlasOffsets UniformAtlasOffsets( const std::size_t _plateCount, const std::size_t _texelCount )
+{
+    AtlasOffsets offsets( _plateCount + 1 );
+    for( std::size_t plateIndex{ 0 }; plateIndex < offsets.size(); ++plateIndex )
+        offsets[ plateIndex ] = plateIndex * _texelCount;
+    return offsets;
+}
+
+// plates are square, a plate texel count being the square of its texture width:
+inline static unsigned PlateWidth( const AtlasOffsets & _offsets, const std::size_t _plate )
+{
+    return static_cast< unsigned >( std::lround( std::sqrt( static_cast< double >( _offsets[ _plate + 1 ] - _offsets[ _plate ] ) ) ) );
+}
+
+template< typename T >
+inline static Vector3Span< T > VecArraySpan( Vector3Array< T > & _array, const std::size_t _offset, const std::size_t _size )
+{
+    return { { _array.x.data() + _offset, _size }, { _array.y.data() + _offset, _size }, { _array.z.data() + _offset, _size } };
+}
+
+template< typename T >
+inline static Vector3Span< const T > VecArraySpan( const Vector3Array< T > & _array, const std::size_t _offset, const std::size_t _size )
+{
+    return { { _array.x.data() + _offset, _size }, { _array.y.data() + _offset, _size }, { _array.z.data() + _offset, _size } };
+}
+
+// transport state of the texels of a plate, in the engine precision, viewed in the atlas of every plate:
+template< typename T >
+struct Texels
+{
+    Vector3Span< T > positions; // texel positions in 3D
+    Vector3Span< T > emitters; // cumulated energy to be emitted next pass
+    Vector3Span< T > receivers; // cumulated received energy
+    unsigned width; // texels per row, the same count of rows
+    std::size_t offset; // first texel of the plate in the atlas
+};
+
+// transport state of every plate, one allocation per array, the plate views pointing into it so that it is moved but never copied:
+template< typename T >
+struct TexelAtlas
+{
+    AtlasOffsets offsets;
+    Vector3Array< T > positions;
+    Vector3Array< T > emitters;
+    Vector3Array< T > receivers;
+    std::vector< Texels< T > > plates;
+
+    TexelAtlas() = default;
+    TexelAtlas( const TexelAtlas & ) = delete;
+    TexelAtlas( TexelAtlas && ) = default;
+    TexelAtlas & operator =( const TexelAtlas & ) = delete;
+    TexelAtlas & operator =( TexelAtlas && ) = default;
+};
+
+// received energy of the texels of every plate, once the transport is over, in one atlas:
+struct Lightmaps
+{
+    AtlasOffsets offsets{ 0 };
+    Vector3Array< Real > texels;
+
+    Lightmaps() = default;
+    explicit Lightmaps( const AtlasOffsets & _offsets ) : offsets{ _offsets }
+    {
+        texels.x.assign( offsets.back(), 0 );
+        texels.y.assign( offsets.back(), 0 );
+        texels.z.assign( offsets.back(), 0 );
+    }
+    Lightmaps( const std::size_t _plateCount, const std::size_t _texelCount ) : Lightmaps{ UniformAtlasOffsets( _plateCount, _texelCount ) } {}
+
+    std::size_t size() const { return offsets.size() - 1; }
+    Vector3Span< Real > operator []( const std::size_t _plate ) { return VecArraySpan( texels, offsets[ _plate ], offsets[ _plate + 1 ] - offsets[ _plate ] ); }
+    Vector3Span< const Real > operator []( const std::size_t _plate ) const { return VecArraySpan( texels, offsets[ _plate ], offsets[ _plate + 1 ] - offsets[ _plate ] ); }
+};
+
+
+enum class KernelIsa { scalar, avx2, avx512 };
+
+inline static const char * KernelIsaName( const KernelIsa _isa )
+{
+    switch( _isa ) {
+        case KernelIsa::avx2: return "avx2";
+        case KernelIsa::avx512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+// best instruction set supported by both the CPU and the OS:
+KernelIsa DetectKernelIsa()
+{
+#if defined( LIGHTSHOT_X86 )
+#if defined( _MSC_VER )
+    int info[ 4 ];
+    ::__cpuid( info, 1 );
+    if( ( info[ 2 ] & ( 1 << 27 ) ) == 0 )
+        return KernelIsa::scalar; // no OSXSAVE
+    const auto xcr0{ ::_xgetbv( 0 ) };
+    ::__cpuidex( info, 7, 0 );
+    if( ( info[ 1 ] & ( 1 << 16 ) ) != 0 && ( xcr0 & 0xe6 ) == 0xe6 )
+        return KernelIsa::avx512;
+    if( ( info[ 1 ] & ( 1 << 5 ) ) != 0 && ( xcr0 & 0x6 ) == 0x6 )
+        return KernelIsa::avx2;
+#else
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx512f" ) )
+        return KernelIsa::avx512;
+    if( __builtin_cpu_supports( "avx2" ) )
+        return KernelIsa::avx2;
+#endif
+#endif
+    return KernelIsa::scalar;
+}
+
 
 Vector3D GetColor( std::mt19937 & _rnd, std::uniform_int_distribution< int > & _rndColorTrigger, const int _rndColorRate )
 {
@@ -95,109 +337,187 @@ Vector3D GetColor( std::mt19937 & _rnd, std::uniform_int_distribution< int > & _
 }
 
 
+// built in two passes over the rows, in parallel: the plate count of every row, then the plates of every row written from its offset
+// in the array allocated once, in row order, the wall colors being drawn from the stream of the row:
 Plates GeneratePlates( const Scene & _scene, const DepthsMap & _depthsMap )
 {
-    //std::random_device rndDevice;
-    //std::mt19937 rnd{ rndDevice() }; // TODO
-    std::mt19937 rnd{ 20 };
-    std::uniform_int_distribution< int > rndColorTrigger( 0, 100 );
-    auto rndColorRate{ 100 - static_cast< int >( _scene.rndColorRate ) };
-    Plates plates;
+    const auto rndColorRate{ 100 - static_cast< int >( _scene.rndColorRate ) };
     const auto halfWidth{ static_cast< Real >( _scene.width ) * _scene.plateWidth * Real{ 0.5 } };
     const auto halfHeight{ static_cast< Real >( _scene.height ) * _scene.plateWidth * Real{ 0.5 } };
-    for( unsigned row{ 0 }; row < _scene.height; ++row ) {
-        const auto & colsMap{ _depthsMap[ row ] };
-        const auto rowTop{ static_cast< Real >( ( row + 0 ) ) * _scene.plateWidth - halfHeight };
-        const auto rowBtm{ static_cast< Real >( ( row + 1 ) ) * _scene.plateWidth - halfHeight };
+    const auto rows{ RowIndices( _scene.height ) };
+
+    // a cell has its floor plate, then a wall plate per depth step towards its right neighbour and towards its bottom one:
+    std::vector< std::size_t > rowFirstPlates( _scene.height + 1, 0 );
+    std::for_each( std::execution::par, rows.begin(), rows.end(), [ & ]( const unsigned _row ) {
+        std::size_t count{ 0 };
+        for( unsigned col{ 0 }; col < _scene.width; ++col ) {
+            const int depth{ _depthsMap( _row, col ) };
+            count += 1;
+            if( col < _scene.width - 1 )
+                count += static_cast< std::size_t >( std::abs( _depthsMap( _row, col + 1 ) - depth ) );
+            if( _row < _scene.height - 1 )
+                count += static_cast< std::size_t >( std::abs( _depthsMap( _row + 1, col ) - depth ) );
+        }
+        rowFirstPlates[ _row + 1 ] = count;
+    } );
+    std::partial_sum( rowFirstPlates.begin(), rowFirstPlates.end(), rowFirstPlates.begin() );
+
+    Plates plates( rowFirstPlates.back() );
+    std::for_each( std::execution::par, rows.begin(), rows.end(), [ & ]( const unsigned _row ) {
+        auto rnd{ RowGenerator( _scene.colorSeed, _row ) };
+        std::uniform_int_distribution< int > rndColorTrigger( 0, 100 );
+        auto itPlate{ plates.begin() + static_cast< std::ptrdiff_t >( rowFirstPlates[ _row ] ) };
+        const auto rowTop{ static_cast< Real >( ( _row + 0 ) ) * _scene.plateWidth - halfHeight };
+        const auto rowBtm{ static_cast< Real >( ( _row + 1 ) ) * _scene.plateWidth - halfHeight };
         for( unsigned col{ 0 }; col < _scene.width; ++col ) {
-            const int depth{ colsMap[ col ] };
+            const int depth{ _depthsMap( _row, col ) };
             const auto currDepth{ static_cast< Real >( depth ) * _scene.plateWidth };
             const auto colLft{ static_cast< Real >( ( col + 0 ) ) * _scene.plateWidth - halfWidth };
             const auto colRgt{ static_cast< Real >( ( col + 1 ) ) * _scene.plateWidth - halfWidth };
-            plates.emplace_back( Plate{
+            *itPlate++ = Plate{
                 { Vector3D{ colLft, rowTop, currDepth }, { colRgt, rowTop, currDepth },
                          { colRgt, rowBtm, currDepth }, { colLft, rowBtm, currDepth } },
-                { Vector2D{ 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } }, Vector3D{ 0, 0, -1 },
-                Material{ { 1, 1, 1 }, _scene.materialRetransmission } } );
+                Vector3D{ 0, 0, -1 },
+                Material{ { 1, 1, 1 }, _scene.materialRetransmission } };
             if( col < _scene.width - 1 ) {
-                const int depth2{ colsMap[ col + 1 ] };
+                const int depth2{ _depthsMap( _row, col + 1 ) };
                 const int depthInc{ depth2 > depth ? 1 : -1 };
                 for( auto d{ depth }; d != depth2; d += depthInc ) {
                     const auto currDepth1{ static_cast< Real >( d ) * _scene.plateWidth };
                     const auto currDepth2{ static_cast< Real >( d + depthInc ) * _scene.plateWidth };
                     const auto normalU{ currDepth1 > currDepth2 ? Real{ -1 } : Real{ 1 } };
-                    plates.emplace_back( Plate{
+                    *itPlate++ = Plate{
                         { Vector3D{ colRgt, rowTop, currDepth1 }, { colRgt, rowTop, currDepth2 },
                                  { colRgt, rowBtm, currDepth2 }, { colRgt, rowBtm, currDepth1 } },
-                        { Vector2D{ 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } }, Vector3D{ normalU, 0, 0 },
-                        Material{ GetColor( rnd, rndColorTrigger, rndColorRate ), _scene.materialRetransmission } } );
+                        Vector3D{ normalU, 0, 0 },
+                        Material{ GetColor( rnd, rndColorTrigger, rndColorRate ), _scene.materialRetransmission } };
                 }
             }
-            if( row < _scene.height - 1 ) {
-                const int depth2{ _depthsMap[ row + 1 ][ col ] };
+            if( _row < _scene.height - 1 ) {
+                const int depth2{ _depthsMap( _row + 1, col ) };
                 const int depthInc{ depth2 > depth ? 1 : -1 };
                 for( auto d{ depth }; d != depth2; d += depthInc ) {
                     const auto currDepth1{ static_cast< Real >( d ) * _scene.plateWidth };
                     const auto currDepth2{ static_cast< Real >( d + depthInc ) * _scene.plateWidth };
                     const auto normalV{ currDepth1 > currDepth2 ? Real{ -1 } : Real{ 1 } };
-                    plates.emplace_back( Plate{
+                    *itPlate++ = Plate{
                         { Vector3D{ colLft, rowBtm, currDepth1 }, { colRgt, rowBtm, currDepth1 },
                                  { colRgt, rowBtm, currDepth2 }, { colLft, rowBtm, currDepth2 } },
-                        { Vector2D{ 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } }, Vector3D{ 0, normalV, 0 },
-                        Material{ GetColor( rnd, rndColorTrigger, rndColorRate ), _scene.materialRetransmission } } );
+                        Vector3D{ 0, normalV, 0 },
+                        Material{ GetColor( rnd, rndColorTrigger, rndColorRate ), _scene.materialRetransmission } };
                 }
             }
         }
-    }
+    } );
     return plates;
 }
 
 
-inline static Vector3D VecSub( const Vector3D & _a, const Vector3D & _b )
+template< typename T >
+inline static Vector3< T > VecSub( const Vector3< T > & _a, const Vector3< T > & _b )
 {
     return { _a[ 0 ] - _b[ 0 ], _a[ 1 ] - _b[ 1 ], _a[ 2 ] - _b[ 2 ] };
 }
 
-inline static Vector3D VecMult( const Vector3D & _a, const Real & _b )
+template< typename T >
+inline static Vector3< T > VecMult( const Vector3< T > & _a, const T & _b )
 {
     return { _a[ 0 ] * _b, _a[ 1 ]  * _b, _a[ 2 ]  * _b };
 }
 
-inline static Vector3D VecMult( const Vector3D & _a, const Vector3D & _b )
+template< typename T >
+inline static Vector3< T > VecMult( const Vector3< T > & _a, const Vector3< T > & _b )
 {
     return { _a[ 0 ] * _b[ 0 ], _a[ 1 ]  * _b[ 1 ], _a[ 2 ]  * _b[ 2 ] };
 }
 
-inline static Vector3D VecAdd( const Vector3D & _a, const Vector3D & _b )
+template< typename T >
+inline static Vector3< T > VecAdd( const Vector3< T > & _a, const Vector3< T > & _b )
 {
     return { _a[ 0 ] + _b[ 0 ], _a[ 1 ] + _b[ 1 ], _a[ 2 ] + _b[ 2 ] };
 }
 
-inline static Vector3D VecCross( const Vector3D & _a, const Vector3D & _b )
+template< typename T >
+inline static Vector3< T > VecCross( const Vector3< T > & _a, const Vector3< T > & _b )
 {
     return { _a[ 1 ] * _b[ 2 ] - _a[ 2 ] * _b[ 1 ], _a[ 2 ] * _b[ 0 ] - _a[ 0 ] * _b[ 2 ], _a[ 0 ] * _b[ 1 ] - _a[ 1 ] * _b[ 0 ] };
 }
 
-inline static Real VecDot( const Vector3D & _a, const Vector3D & _b )
+template< typename T >
+inline static T VecDot( const Vector3< T > & _a, const Vector3< T > & _b )
 {
     return _a[ 0 ] * _b[ 0 ] + _a[ 1 ] * _b[ 1 ] + _a[ 2 ] * _b[ 2 ];
 }
 
-inline static Real VecDist( const Vector3D & _a, const Vector3D & _b )
+template< typename T >
+inline static T VecDist( const Vector3< T > & _a, const Vector3< T > & _b )
 {
     const auto sub{ VecSub( _b, _a ) };
-    return std::sqrt( std::pow( sub[ 0 ], 2 ) + std::pow( sub[ 1 ], 2 ) + std::pow( sub[ 2 ], 2 ) );
+    return std::sqrt( sub[ 0 ] * sub[ 0 ] + sub[ 1 ] * sub[ 1 ] + sub[ 2 ] * sub[ 2 ] );
+}
+
+template< typename T >
+inline static Vector3< T > VecNorm( const Vector3< T > & _a )
+{
+    return VecMult( _a, T{ 1 } / VecDist( { 0, 0, 0 }, _a ) );
+}
+
+template< typename U, typename T >
+inline static Vector3< U > VecCast( const Vector3< T > & _a )
+{
+    return { static_cast< U >( _a[ 0 ] ), static_cast< U >( _a[ 1 ] ), static_cast< U >( _a[ 2 ] ) };
+}
+
+
+template< typename T >
+inline static Vector3< T > VecArrayGet( const Vector3Array< T > & _array, const std::size_t _index )
+{
+    return { _array.x[ _index ], _array.y[ _index ], _array.z[ _index ] };
+}
+
+template< typename T >
+inline static void VecArraySet( Vector3Array< T > & _array, const std::size_t _index, const Vector3< T > & _value )
+{
+    _array.x[ _index ] = _value[ 0 ];
+    _array.y[ _index ] = _value[ 1 ];
+    _array.z[ _index ] = _value[ 2 ];
+}
+
+template< typename T >
+inline static void VecArrayReset( Vector3Array< T > & _array, const std::size_t _size )
+{
+    _array.x.assign( _size, 0 );
+    _array.y.assign( _size, 0 );
+    _array.z.assign( _size, 0 );
+}
+
+template< typename T >
+inline static Vector3< std::remove_const_t< T > > VecArrayGet( const Vector3Span< T > & _span, const std::size_t _index )
+{
+    return { _span.x[ _index ], _span.y[ _index ], _span.z[ _index ] };
+}
+
+template< typename T >
+inline static void VecArraySet( const Vector3Span< T > & _span, const std::size_t _index, const Vector3< T > & _value )
+{
+    _span.x[ _index ] = _value[ 0 ];
+    _span.y[ _index ] = _value[ 1 ];
+    _span.z[ _index ] = _value[ 2 ];
 }
 
-inline static Vector3D VecNorm( const Vector3D & _a )
+template< typename T >
+inline static void VecArrayClear( const Vector3Span< T > & _span )
 {
-    return VecMult( _a, Real{ 1 } / VecDist( { 0, 0, 0 }, _a ) );
+    std::fill( _span.x.begin(), _span.x.end(), T{ 0 } );
+    std::fill( _span.y.begin(), _span.y.end(), T{ 0 } );
+    std::fill( _span.z.begin(), _span.z.end(), T{ 0 } );
 }
 
 
 inline static const Real epsilon{ std::numeric_limits< Real >::min() };
 
-inline static bool SegmentIntersectsTriangle( const Vector3D & _p0, const Vector3D & _p1,
+// segment parameter of the crossing with a triangle, none when the segment does not cross it:
+inline static std::optional< Real > SegmentTriangleHit( const Vector3D & _p0, const Vector3D & _p1,
     const Vector3D & _a, const Vector3D & _b, const Vector3D & _c )
 {
     const auto dir{ VecSub( _p1, _p0 ) };
@@ -206,20 +526,26 @@ inline static bool SegmentIntersectsTriangle( const Vector3D & _p0, const Vector
     const auto h{ VecCross( dir, edge2 ) };
     const auto a{ VecDot( edge1, h ) };
     if( a < epsilon && a > -epsilon )
-        return false;
+        return std::nullopt;
     const auto f{ Real{ 1 } / a };
     const auto s{ VecSub( _p0, _a ) };
     const auto u{ f * VecDot( s, h ) };
     if( u < Real{ 0 } || u > Real{ 1 } )
-        return false;
+        return std::nullopt;
     const auto q{ VecCross( s, edge1 ) };
     const auto v{ f * VecDot( dir, q ) };
     if( v < Real{ 0 } || ( u + v ) > Real{ 1 } )
-        return false;
+        return std::nullopt;
     const auto t{ f * VecDot( edge2, q ) };
     if( t > epsilon && t < Real{ 1 } + epsilon )
-        return true;
-    return false;
+        return t;
+    return std::nullopt;
+}
+
+inline static bool SegmentIntersectsTriangle( const Vector3D & _p0, const Vector3D & _p1,
+    const Vector3D & _a, const Vector3D & _b, const Vector3D & _c )
+{
+    return SegmentTriangleHit( _p0, _p1, _a, _b, _c ).has_value();
 }
 
 inline static bool VecInPlane( const Vector3D & _p, const Vector3D & _a, const Vector3D & _b, const Vector3D & _c )
@@ -228,326 +554,4399 @@ inline static bool VecInPlane( const Vector3D & _p, const Vector3D & _a, const V
     return std::abs( VecDot( normal, _p ) - VecDot( normal, _a ) ) < epsilon;
 }
 
-inline static bool VecFacing( const Vector3D & _a, const Vector3D & _b )
+template< typename T >
+inline static bool VecFacing( const Vector3< T > & _a, const Vector3< T > & _b )
 {
     return VecDot( _a, _b ) <= 0;
 }
 
 
-int main( int _argc, char * _argv[] )
+inline static bool SegmentIntersectsPlate( const Vector3D & _p0, const Vector3D & _p1, const Quad & _quad )
 {
-    std::cout << "[lightshot] a CPU-based photon tracer" << std::endl << std::endl;
-    unsigned defaultResolution{ 16 };
-    std::cout << "usage: Lightshot resolution (must be a power of two, default is " << defaultResolution << ")" << std::endl;
+    const auto & a{ _quad[ 0 ] };
+    const auto & c{ _quad[ 2 ] };
+    return SegmentIntersectsTriangle( _p0, _p1, a, _quad[ 1 ], c ) ||
+           SegmentIntersectsTriangle( _p0, _p1, c, _quad[ 3 ], a );
+}
 
-    unsigned resolution{ 0 };
-    if( _argc == 2 )
-        resolution = std::atoi( _argv[ 1 ] );
-    const bool resolutionIsPowerOfTwo{ ( resolution > 0 ) && ( ( resolution & ( resolution - 1 ) ) == 0 ) };
-    if( resolution == 0 || !resolutionIsPowerOfTwo ) {
-        std::cout << "> no parameter, bad parameter, or parameter value is not a power of two: using default." << std::endl << std::endl;
-        resolution = defaultResolution;
+// reference occlusion test, every plate but the receiving one is tested:
+inline static bool SegmentOccludedBruteForce( const Quads & _quads, const Vector3D & _p0, const Vector3D & _p1, const std::size_t _skippedPlate, std::uint64_t & _triangleCount )
+{
+    for( std::size_t j{ 0 }; j < _quads.size(); ++j ) {
+        if( j == _skippedPlate )
+            continue;
+        _triangleCount += 2;
+        if( SegmentIntersectsPlate( _p0, _p1, _quads[ j ] ) )
+            return true;
     }
-    
-    std::cout << "press 'space' key to toggle between linear/nearest texture filter" << std::endl;
-    std::cout << "press 'esc' key to exit" << std::endl << std::endl;
+    return false;
+}
 
-    const Scene scene{
-        7, 7, // scene dimensions
-        2, // scene depth
-        25, // depth rate
-        30, // color rate
-        1, // plate width
-        resolution, // texture width
-        0.5, // material energy retransmission ratio
-        10, // wavelength decay distance
-        { 0.8, 0.9, 1 }, // wavelength decay
-    };
 
-    static constexpr unsigned maxRenderingPass{ 4 }; // maximum rendering pass
-                
-    static constexpr Real realMultiplier{ 1000 }; // increase precision on real cumulation operations
-    static const auto lightResolution{ Real{ 1 } / std::pow( scene.textureWidth, 2 ) };
-    bool nearestTextureRendering{ false }; // nearest or linear interpolation
+struct Bounds
+{
+    Vector3D min;
+    Vector3D max;
+};
 
-    // generate depths map and related plates:
-    auto plates{ GeneratePlates( scene, GenerateDepthsMap( scene ) ) };
+// triangles of a tree leaf in structure of arrays with precomputed edges, tested against a segment at once,
+// unused slots hold degenerate triangles which are never hit:
+struct alignas( 64 ) OccluderBlock
+{
+    static constexpr std::size_t size{ 8 };
+    std::array< Real, size > ax, ay, az;
+    std::array< Real, size > edge1x, edge1y, edge1z;
+    std::array< Real, size > edge2x, edge2y, edge2z;
+    std::array< std::uint64_t, size > plates;
+};
 
-    std::cout << plates.size() << " plates, resolution: " << scene.textureWidth << "x" << scene.textureWidth << std::endl;
-    std::cout << "material light retransmission rate: " << static_cast< int >( scene.materialRetransmission * 100 ) << "%" << std::endl;
-    
-    // prepare plates:
-    std::for_each( std::execution::par_unseq, plates.begin(), plates.end(), [ & ]( auto & _plate ) {
-        
-        // init and reset receiver buffer:
-        _plate.receivers.resize( scene.textureWidth * scene.textureWidth );
-        std::memset( _plate.receivers.data(), 0, scene.textureWidth * scene.textureWidth * sizeof( Vector3D ) );
-
-        // init emitter buffer:
-        _plate.emitters.resize( scene.textureWidth * scene.textureWidth );
-        auto itEmitter{ _plate.emitters.begin() };
+// same triangle split as SegmentIntersectsPlate:
+inline static void SetOccluderTriangle( OccluderBlock & _block, const std::size_t _slot, const std::size_t _plate, const Vector3D & _a, const Vector3D & _b, const Vector3D & _c )
+{
+    const auto edge1{ VecSub( _b, _a ) };
+    const auto edge2{ VecSub( _c, _a ) };
+    _block.ax[ _slot ] = _a[ 0 ]; _block.ay[ _slot ] = _a[ 1 ]; _block.az[ _slot ] = _a[ 2 ];
+    _block.edge1x[ _slot ] = edge1[ 0 ]; _block.edge1y[ _slot ] = edge1[ 1 ]; _block.edge1z[ _slot ] = edge1[ 2 ];
+    _block.edge2x[ _slot ] = edge2[ 0 ]; _block.edge2y[ _slot ] = edge2[ 1 ]; _block.edge2z[ _slot ] = edge2[ 2 ];
+    _block.plates[ _slot ] = _plate;
+}
 
-        // precompute positions of each texture point in 3D:
-        const auto & a{ _plate.positions[ 0 ] };
-        const auto ba{ VecSub( _plate.positions[ 1 ], a ) };
-        const auto da{ VecSub( _plate.positions[ 3 ], a ) };
-        for( unsigned int y{ 0 }; y < scene.textureWidth; ++y ) {
-            const auto daY{ VecMult( da, ( static_cast< Real >( y ) + Real{ 0.5 } ) / scene.textureWidth ) };
-            for( unsigned int x{ 0 }; x < scene.textureWidth; ++x, ++itEmitter ) {
-                const auto baX{ VecMult( ba, ( static_cast< Real >( x ) + Real{ 0.5 } ) / scene.textureWidth ) };
-                itEmitter->position = VecAdd( VecAdd( a, baX ), daY ); // save position in emitter
-                itEmitter->color = Vector3D{ 0, 0, 0 }; // reset emitter color
+inline static OccluderBlock EmptyOccluderBlock()
+{
+    OccluderBlock block{};
+    block.plates.fill( std::numeric_limits< std::uint64_t >::max() );
+    return block;
+}
+
+// scalar reference of the packet tests below, Möller–Trumbore on every slot:
+bool SegmentIntersectsBlockScalar( const OccluderBlock & _block, const Vector3D & _p0, const Vector3D & _dir, const std::size_t _skippedPlate )
+{
+    for( std::size_t slot{ 0 }; slot < OccluderBlock::size; ++slot ) {
+        if( _block.plates[ slot ] == _skippedPlate )
+            continue;
+        const Vector3D edge1{ _block.edge1x[ slot ], _block.edge1y[ slot ], _block.edge1z[ slot ] };
+        const Vector3D edge2{ _block.edge2x[ slot ], _block.edge2y[ slot ], _block.edge2z[ slot ] };
+        const auto h{ VecCross( _dir, edge2 ) };
+        const auto a{ VecDot( edge1, h ) };
+        if( a < epsilon && a > -epsilon )
+            continue;
+        const auto f{ Real{ 1 } / a };
+        const auto s{ VecSub( _p0, { _block.ax[ slot ], _block.ay[ slot ], _block.az[ slot ] } ) };
+        const auto u{ f * VecDot( s, h ) };
+        if( u < Real{ 0 } || u > Real{ 1 } )
+            continue;
+        const auto q{ VecCross( s, edge1 ) };
+        const auto v{ f * VecDot( _dir, q ) };
+        if( v < Real{ 0 } || ( u + v ) > Real{ 1 } )
+            continue;
+        const auto t{ f * VecDot( edge2, q ) };
+        if( t > epsilon && t < Real{ 1 } + epsilon )
+            return true;
+    }
+    return false;
+}
+
+// one segment against the 8 triangles of a block, every comparison keeps the scalar semantic on NaN (unordered
+// comparisons for the rejections, ordered ones for the acceptance), so that decisions are bit-identical:
+#if defined( LIGHTSHOT_X86 )
+LIGHTSHOT_TARGET( "avx2" )
+bool SegmentIntersectsBlockAvx2( const OccluderBlock & _block, const Vector3D & _p0, const Vector3D & _dir, const std::size_t _skippedPlate )
+{
+    constexpr std::size_t lanes{ 4 };
+    const auto dirX{ _mm256_set1_pd( _dir[ 0 ] ) };
+    const auto dirY{ _mm256_set1_pd( _dir[ 1 ] ) };
+    const auto dirZ{ _mm256_set1_pd( _dir[ 2 ] ) };
+    const auto p0X{ _mm256_set1_pd( _p0[ 0 ] ) };
+    const auto p0Y{ _mm256_set1_pd( _p0[ 1 ] ) };
+    const auto p0Z{ _mm256_set1_pd( _p0[ 2 ] ) };
+    const auto one{ _mm256_set1_pd( 1 ) };
+    const auto zero{ _mm256_setzero_pd() };
+    const auto eps{ _mm256_set1_pd( epsilon ) };
+    const auto minusEps{ _mm256_set1_pd( -epsilon ) };
+    const auto onePlusEps{ _mm256_set1_pd( Real{ 1 } + epsilon ) };
+    const auto skipped{ _mm256_set1_epi64x( static_cast< long long >( _skippedPlate ) ) };
+    for( std::size_t slot{ 0 }; slot < OccluderBlock::size; slot += lanes ) {
+        const auto e1x{ _mm256_load_pd( _block.edge1x.data() + slot ) };
+        const auto e1y{ _mm256_load_pd( _block.edge1y.data() + slot ) };
+        const auto e1z{ _mm256_load_pd( _block.edge1z.data() + slot ) };
+        const auto e2x{ _mm256_load_pd( _block.edge2x.data() + slot ) };
+        const auto e2y{ _mm256_load_pd( _block.edge2y.data() + slot ) };
+        const auto e2z{ _mm256_load_pd( _block.edge2z.data() + slot ) };
+        const auto hx{ _mm256_sub_pd( _mm256_mul_pd( dirY, e2z ), _mm256_mul_pd( dirZ, e2y ) ) };
+        const auto hy{ _mm256_sub_pd( _mm256_mul_pd( dirZ, e2x ), _mm256_mul_pd( dirX, e2z ) ) };
+        const auto hz{ _mm256_sub_pd( _mm256_mul_pd( dirX, e2y ), _mm256_mul_pd( dirY, e2x ) ) };
+        const auto a{ _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( e1x, hx ), _mm256_mul_pd( e1y, hy ) ), _mm256_mul_pd( e1z, hz ) ) };
+        const auto f{ _mm256_div_pd( one, a ) };
+        const auto sx{ _mm256_sub_pd( p0X, _mm256_load_pd( _block.ax.data() + slot ) ) };
+        const auto sy{ _mm256_sub_pd( p0Y, _mm256_load_pd( _block.ay.data() + slot ) ) };
+        const auto sz{ _mm256_sub_pd( p0Z, _mm256_load_pd( _block.az.data() + slot ) ) };
+        const auto u{ _mm256_mul_pd( f, _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( sx, hx ), _mm256_mul_pd( sy, hy ) ), _mm256_mul_pd( sz, hz ) ) ) };
+        const auto qx{ _mm256_sub_pd( _mm256_mul_pd( sy, e1z ), _mm256_mul_pd( sz, e1y ) ) };
+        const auto qy{ _mm256_sub_pd( _mm256_mul_pd( sz, e1x ), _mm256_mul_pd( sx, e1z ) ) };
+        const auto qz{ _mm256_sub_pd( _mm256_mul_pd( sx, e1y ), _mm256_mul_pd( sy, e1x ) ) };
+        const auto v{ _mm256_mul_pd( f, _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( dirX, qx ), _mm256_mul_pd( dirY, qy ) ), _mm256_mul_pd( dirZ, qz ) ) ) };
+        const auto t{ _mm256_mul_pd( f, _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( e2x, qx ), _mm256_mul_pd( e2y, qy ) ), _mm256_mul_pd( e2z, qz ) ) ) };
+        auto hit{ _mm256_or_pd( _mm256_cmp_pd( a, eps, _CMP_NLT_UQ ), _mm256_cmp_pd( a, minusEps, _CMP_NGT_UQ ) ) };
+        hit = _mm256_and_pd( hit, _mm256_and_pd( _mm256_cmp_pd( u, zero, _CMP_NLT_UQ ), _mm256_cmp_pd( u, one, _CMP_NGT_UQ ) ) );
+        hit = _mm256_and_pd( hit, _mm256_and_pd( _mm256_cmp_pd( v, zero, _CMP_NLT_UQ ), _mm256_cmp_pd( _mm256_add_pd( u, v ), one, _CMP_NGT_UQ ) ) );
+        hit = _mm256_and_pd( hit, _mm256_and_pd( _mm256_cmp_pd( t, eps, _CMP_GT_OQ ), _mm256_cmp_pd( t, onePlusEps, _CMP_LT_OQ ) ) );
+        const auto skippedLanes{ _mm256_cmpeq_epi64( _mm256_load_si256( reinterpret_cast< const __m256i * >( _block.plates.data() + slot ) ), skipped ) };
+        hit = _mm256_andnot_pd( _mm256_castsi256_pd( skippedLanes ), hit );
+        if( _mm256_movemask_pd( hit ) != 0 )
+            return true;
+    }
+    return false;
+}
+
+LIGHTSHOT_TARGET( "avx512f" )
+bool SegmentIntersectsBlockAvx512( const OccluderBlock & _block, const Vector3D & _p0, const Vector3D & _dir, const std::size_t _skippedPlate )
+{
+    const auto dirX{ _mm512_set1_pd( _dir[ 0 ] ) };
+    const auto dirY{ _mm512_set1_pd( _dir[ 1 ] ) };
+    const auto dirZ{ _mm512_set1_pd( _dir[ 2 ] ) };
+    const auto one{ _mm512_set1_pd( 1 ) };
+    const auto zero{ _mm512_setzero_pd() };
+    const auto e1x{ _mm512_load_pd( _block.edge1x.data() ) };
+    const auto e1y{ _mm512_load_pd( _block.edge1y.data() ) };
+    const auto e1z{ _mm512_load_pd( _block.edge1z.data() ) };
+    const auto e2x{ _mm512_load_pd( _block.edge2x.data() ) };
+    const auto e2y{ _mm512_load_pd( _block.edge2y.data() ) };
+    const auto e2z{ _mm512_load_pd( _block.edge2z.data() ) };
+    const auto hx{ _mm512_sub_pd( _mm512_mul_pd( dirY, e2z ), _mm512_mul_pd( dirZ, e2y ) ) };
+    const auto hy{ _mm512_sub_pd( _mm512_mul_pd( dirZ, e2x ), _mm512_mul_pd( dirX, e2z ) ) };
+    const auto hz{ _mm512_sub_pd( _mm512_mul_pd( dirX, e2y ), _mm512_mul_pd( dirY, e2x ) ) };
+    const auto a{ _mm512_add_pd( _mm512_add_pd( _mm512_mul_pd( e1x, hx ), _mm512_mul_pd( e1y, hy ) ), _mm512_mul_pd( e1z, hz ) ) };
+    auto hit{ static_cast< __mmask8 >( _mm512_cmp_pd_mask( a, _mm512_set1_pd( epsilon ), _CMP_NLT_UQ ) | _mm512_cmp_pd_mask( a, _mm512_set1_pd( -epsilon ), _CMP_NGT_UQ ) ) };
+    hit &= _mm512_cmpneq_epi64_mask( _mm512_load_si512( _block.plates.data() ), _mm512_set1_epi64( static_cast< long long >( _skippedPlate ) ) );
+    if( hit == 0 )
+        return false;
+    const auto f{ _mm512_div_pd( one, a ) };
+    const auto sx{ _mm512_sub_pd( _mm512_set1_pd( _p0[ 0 ] ), _mm512_load_pd( _block.ax.data() ) ) };
+    const auto sy{ _mm512_sub_pd( _mm512_set1_pd( _p0[ 1 ] ), _mm512_load_pd( _block.ay.data() ) ) };
+    const auto sz{ _mm512_sub_pd( _mm512_set1_pd( _p0[ 2 ] ), _mm512_load_pd( _block.az.data() ) ) };
+    const auto u{ _mm512_mul_pd( f, _mm512_add_pd( _mm512_add_pd( _mm512_mul_pd( sx, hx ), _mm512_mul_pd( sy, hy ) ), _mm512_mul_pd( sz, hz ) ) ) };
+    hit &= _mm512_cmp_pd_mask( u, zero, _CMP_NLT_UQ ) & _mm512_cmp_pd_mask( u, one, _CMP_NGT_UQ );
+    const auto qx{ _mm512_sub_pd( _mm512_mul_pd( sy, e1z ), _mm512_mul_pd( sz, e1y ) ) };
+    const auto qy{ _mm512_sub_pd( _mm512_mul_pd( sz, e1x ), _mm512_mul_pd( sx, e1z ) ) };
+    const auto qz{ _mm512_sub_pd( _mm512_mul_pd( sx, e1y ), _mm512_mul_pd( sy, e1x ) ) };
+    const auto v{ _mm512_mul_pd( f, _mm512_add_pd( _mm512_add_pd( _mm512_mul_pd( dirX, qx ), _mm512_mul_pd( dirY, qy ) ), _mm512_mul_pd( dirZ, qz ) ) ) };
+    hit &= _mm512_cmp_pd_mask( v, zero, _CMP_NLT_UQ ) & _mm512_cmp_pd_mask( _mm512_add_pd( u, v ), one, _CMP_NGT_UQ );
+    const auto t{ _mm512_mul_pd( f, _mm512_add_pd( _mm512_add_pd( _mm512_mul_pd( e2x, qx ), _mm512_mul_pd( e2y, qy ) ), _mm512_mul_pd( e2z, qz ) ) ) };
+    hit &= _mm512_cmp_pd_mask( t, _mm512_set1_pd( epsilon ), _CMP_GT_OQ ) & _mm512_cmp_pd_mask( t, _mm512_set1_pd( Real{ 1 } + epsilon ), _CMP_LT_OQ );
+    return hit != 0;
+}
+#endif
+
+using BlockIntersection = bool ( * )( const OccluderBlock &, const Vector3D &, const Vector3D &, std::size_t );
+
+BlockIntersection SelectBlockIntersection( const KernelIsa _isa )
+{
+#if defined( LIGHTSHOT_X86 )
+    if( _isa == KernelIsa::avx512 )
+        return SegmentIntersectsBlockAvx512;
+    if( _isa == KernelIsa::avx2 )
+        return SegmentIntersectsBlockAvx2;
+#endif
+    return SegmentIntersectsBlockScalar;
+}
+
+// randomized comparison of the packet tests against SegmentIntersectsTriangle, on random, grid-snapped (exact edge
+// and vertex hits, coplanar segments) and degenerate triangles, returns the number of mismatching decisions:
+std::size_t CheckBlockIntersections( const std::size_t _trials, const KernelIsa _supportedIsa )
+{
+    std::mt19937 rnd{ 7 };
+    std::uniform_real_distribution< Real > rndCoordinate( -4, 4 );
+    std::uniform_int_distribution< int > rndGrid( -8, 8 );
+    std::uniform_int_distribution< int > rndKind( 0, 9 );
+    std::uniform_int_distribution< int > rndSlot( 0, OccluderBlock::size - 1 );
+    const auto RandomPoint{ [ & ]( const bool _snapped ) {
+            return _snapped ? Vector3D{ rndGrid( rnd ) * Real{ 0.5 }, rndGrid( rnd ) * Real{ 0.5 }, rndGrid( rnd ) * Real{ 0.5 } }
+                            : Vector3D{ rndCoordinate( rnd ), rndCoordinate( rnd ), rndCoordinate( rnd ) };
+        } };
+    std::size_t mismatchCount{ 0 };
+    for( int isa{ static_cast< int >( KernelIsa::scalar ) }; isa <= static_cast< int >( _supportedIsa ); ++isa ) {
+        const auto BlockIntersects{ SelectBlockIntersection( static_cast< KernelIsa >( isa ) ) };
+        std::size_t hitCount{ 0 };
+        std::size_t isaMismatchCount{ 0 };
+        for( std::size_t trial{ 0 }; trial < _trials; ++trial ) {
+            const bool snapped{ rndKind( rnd ) < 5 };
+            const auto p0{ RandomPoint( snapped ) };
+            const auto p1{ RandomPoint( snapped ) };
+            const auto skippedPlate{ static_cast< std::size_t >( rndSlot( rnd ) ) };
+            const bool singleTriangle{ trial % 2 == 0 }; // single filled slot, to compare each decision on its own
+            const auto singleSlot{ static_cast< std::size_t >( rndSlot( rnd ) ) };
+            auto block{ EmptyOccluderBlock() };
+            bool expected{ false };
+            for( std::size_t slot{ 0 }; slot < OccluderBlock::size; ++slot ) {
+                if( singleTriangle && slot != singleSlot )
+                    continue;
+                const auto kind{ rndKind( rnd ) };
+                const auto a{ kind == 0 ? p0 : RandomPoint( snapped ) }; // segment starting on a vertex
+                const auto b{ kind == 1 ? a : RandomPoint( snapped ) }; // degenerate triangle
+                const auto c{ RandomPoint( snapped ) };
+                SetOccluderTriangle( block, slot, slot, a, b, c );
+                expected = expected || ( slot != skippedPlate && SegmentIntersectsTriangle( p0, p1, a, b, c ) );
             }
+            const auto result{ BlockIntersects( block, p0, VecSub( p1, p0 ), skippedPlate ) };
+            hitCount += result ? 1 : 0;
+            isaMismatchCount += result != expected ? 1 : 0;
         }
-    } );
+        std::cout << KernelIsaName( static_cast< KernelIsa >( isa ) ) << " packet test: " << _trials << " segment(s), " << hitCount << " hit(s), "
+                  << isaMismatchCount << " mismatch(es) against the scalar test" << std::endl;
+        mismatchCount += isaMismatchCount;
+    }
+    return mismatchCount;
+}
 
-    // light sources:
-    const std::vector< Photon > lightSources{
-        { { 1.01, 3.23, -2.34 }, { 0, 0, 1 }, VecMult( Vector3D{ 1, 0.95, 0.9 }, Real{ 0.2 } / Real{ maxRenderingPass } ) }
+
+// bounding volume hierarchy over the plates, built once and queried by the occlusion test:
+struct OcclusionTree
+{
+    struct Node
+    {
+        Bounds bounds;
+        unsigned first; // first plate index in leaf, left child index otherwise (right child follows it)
+        unsigned count; // plate count, zero for inner nodes
+        unsigned block; // occluder block of the leaf
     };
+    std::vector< Node > nodes;
+    std::vector< unsigned > plateIndices;
+    std::vector< OccluderBlock > blocks;
+};
 
-    // initial photons list:
-    std::vector< Photon > photons;
-    const auto textureWidth{ static_cast< Real >( scene.textureWidth ) };
-    const auto halfPlateWidth{ scene.plateWidth / 2 };
-    for( const auto & lightSource : lightSources ) {
-        const auto & position{ lightSource.position };
-        const auto color{ VecMult( lightSource.color, realMultiplier * lightResolution ) };
-        for( unsigned y{ 0 }; y < scene.textureWidth; ++y ) {
-            const auto shiftY{ ( static_cast< Real >( y ) * scene.plateWidth / textureWidth ) - halfPlateWidth };
-            for( unsigned x{ 0 }; x < scene.textureWidth; ++x ) {
-                const auto shiftX{ ( static_cast< Real >( x ) * scene.plateWidth / textureWidth ) - halfPlateWidth };
-                photons.emplace_back( Photon{ VecAdd( VecMult( position, scene.plateWidth ), Vector3D{ shiftX, shiftY, 0 } ), lightSource.normal, color } );
-            }
+// bounds are slightly inflated so that a hit accepted by SegmentIntersectsTriangle can never be culled by rounding:
+inline static constexpr Real boundsPadding{ 0.000001 };
+inline static constexpr unsigned maxPlatesPerLeaf{ OccluderBlock::size / 2 };
+
+inline static Bounds PlateBounds( const Quad & _positions )
+{
+    Bounds bounds{ _positions[ 0 ], _positions[ 0 ] };
+    for( const auto & position : _positions ) {
+        for( int i{ 0 }; i < 3; ++i ) {
+            bounds.min[ i ] = std::min( bounds.min[ i ], position[ i ] - boundsPadding );
+            bounds.max[ i ] = std::max( bounds.max[ i ], position[ i ] + boundsPadding );
         }
     }
+    return bounds;
+}
 
-    // progress bar:
-    unsigned plateCompleted{ 0 };
-    const auto Progress{ [ & ]{
-            static const auto Draw{ []( const unsigned _length, const char _char ){ for( unsigned i{ 0 }; i < _length; ++i ) std::cout << _char; } };
-            static std::mutex mtx;
-            std::lock_guard lock{ mtx };
-            const unsigned percent{ plateCompleted * 100 / static_cast< unsigned >( plates.size() ) };
-            constexpr unsigned length{ 50 };
-            constexpr unsigned lengthMargin{ length + 7 };
-            Draw( lengthMargin, '\r' );
-            const unsigned barLength{ plateCompleted * length / static_cast< unsigned >( plates.size() ) };
-            std::cout << "[";
-            Draw( barLength, 'O' );
-            Draw( length - barLength, ' ' );
-            std::cout << "] " << percent << "%";
-            if( ++plateCompleted != plates.size() )
-                return;
-            Draw( lengthMargin, '\r' ); Draw( lengthMargin, ' ' ); Draw( lengthMargin, '\r' );
-        } };
+inline static Bounds PlateBounds( const Plate & _plate )
+{
+    return PlateBounds( _plate.positions );
+}
 
-    const auto t0{ std::chrono::high_resolution_clock::now() };
+inline static Bounds BoundsUnion( const Bounds & _a, const Bounds & _b )
+{
+    return { { std::min( _a.min[ 0 ], _b.min[ 0 ] ), std::min( _a.min[ 1 ], _b.min[ 1 ] ), std::min( _a.min[ 2 ], _b.min[ 2 ] ) },
+             { std::max( _a.max[ 0 ], _b.max[ 0 ] ), std::max( _a.max[ 1 ], _b.max[ 1 ] ), std::max( _a.max[ 2 ], _b.max[ 2 ] ) } };
+}
 
-    // rendering pass for each photo list:
-    unsigned renderingPass{ 0 };
-    while( !photons.empty() && renderingPass++ != maxRenderingPass ) {
-        std::cout << "pass " << renderingPass << "/" << maxRenderingPass << " - " << photons.size() << " photon(s)" << std::endl;
-
-        // for each plate:
-        plateCompleted = 0;
-        std::for_each( std::execution::par_unseq, plates.begin(), plates.end(), [ & ]( auto & _plate ) {
-
-            // for each photon:
-            for( const auto & photon : photons ) {
-                
-                // for each texture point:
-                auto itEmitter{ _plate.emitters.begin() };
-                for( auto itReceiver{ _plate.receivers.begin() }; itReceiver != _plate.receivers.cend(); ++itReceiver, ++itEmitter ) {
-                    auto & receiver{ *itReceiver };
-                    auto & emitter{ *itEmitter };
-                    const auto & position{ emitter.position };
-
-                    const auto rayNormal{ VecNorm( VecSub( photon.position, position ) ) };
-                    if( !VecFacing( rayNormal, photon.normal ) )
-                        continue; // the normal of the ray is not facing the photon ray
-
-                    // intersections with other plates:
-                    bool intersect{ false };
-                    for( int j{ 0 }; !intersect && j < plates.size(); ++j ) {
-                        const auto & plate2{ plates[ j ] };
-                        if( &_plate == &plate2 )
-                            continue;
-                        const auto & a2{ plate2.positions[ 0 ] };
-                        const auto & c2{ plate2.positions[ 2 ] };
-                        intersect = SegmentIntersectsTriangle( position, photon.position, a2, plate2.positions[ 1 ], c2 ) ||
-                                    SegmentIntersectsTriangle( position, photon.position, c2, plate2.positions[ 3 ], a2 );
-                    }
-                    if( intersect )
-                        continue; // ray intersects with something
-
-                    // distance:
-                    const auto distance{ VecDist( photon.position, position ) };
-                    const Real distanceFactor{ std::pow( 1 - ( distance < scene.wavelengthDecayDistance ? distance / scene.wavelengthDecayDistance : 1 ), 1 ) };
-                    const auto wavelengthDecay{ VecAdd( scene.wavelengthDecay, VecMult( VecSub( { 1, 1, 1 }, scene.wavelengthDecay ), distanceFactor ) ) };
-                    
-                    // compute received power value:
-                    const auto raySrcAngle{ -VecDot( photon.normal, rayNormal ) };
-                    const auto received{ VecMult( VecMult( VecMult( photon.color, _plate.material.color ), wavelengthDecay ), raySrcAngle ) };
-                    receiver = VecAdd( receiver, received );
-                    emitter.color = VecAdd( emitter.color, VecMult( received, _plate.material.retransmission ) ); // cumulated energy transmission
+inline static bool BoundsOverlap( const Bounds & _a, const Bounds & _b )
+{
+    for( int i{ 0 }; i < 3; ++i )
+        if( _a.max[ i ] < _b.min[ i ] || _b.max[ i ] < _a.min[ i ] )
+            return false;
+    return true;
+}
+
+OcclusionTree BuildOcclusionTree( const Quads & _quads )
+{
+    OcclusionTree tree;
+    if( _quads.empty() )
+        return tree;
+    std::vector< Bounds > platesBounds;
+    std::vector< Vector3D > centers;
+    for( const auto & quad : _quads ) {
+        const auto & bounds{ platesBounds.emplace_back( PlateBounds( quad ) ) };
+        centers.emplace_back( VecMult( VecAdd( bounds.min, bounds.max ), Real{ 0.5 } ) );
+    }
+    tree.plateIndices.resize( _quads.size() );
+    std::iota( tree.plateIndices.begin(), tree.plateIndices.end(), 0 );
+
+    // recursive median split along the widest axis of the plate centers:
+    const auto Build{ [ & ]( const auto & _Build, const unsigned _nodeIndex, const unsigned _first, const unsigned _count ) -> void {
+            const auto itFirst{ tree.plateIndices.begin() + _first };
+            const auto itLast{ itFirst + _count };
+            Bounds bounds{ platesBounds[ *itFirst ] };
+            Bounds centerBounds{ centers[ *itFirst ], centers[ *itFirst ] };
+            for( auto it{ itFirst }; it != itLast; ++it ) {
+                bounds = BoundsUnion( bounds, platesBounds[ *it ] );
+                centerBounds = BoundsUnion( centerBounds, { centers[ *it ], centers[ *it ] } );
+            }
+            tree.nodes[ _nodeIndex ].bounds = bounds;
+            if( _count <= maxPlatesPerLeaf ) {
+                tree.nodes[ _nodeIndex ].first = _first;
+                tree.nodes[ _nodeIndex ].count = _count;
+                tree.nodes[ _nodeIndex ].block = static_cast< unsigned >( tree.blocks.size() );
+                auto & block{ tree.blocks.emplace_back( EmptyOccluderBlock() ) };
+                for( unsigned i{ 0 }; i < _count; ++i ) {
+                    const auto plateIndex{ tree.plateIndices[ _first + i ] };
+                    const auto & positions{ _quads[ plateIndex ] };
+                    SetOccluderTriangle( block, 2 * i, plateIndex, positions[ 0 ], positions[ 1 ], positions[ 2 ] );
+                    SetOccluderTriangle( block, 2 * i + 1, plateIndex, positions[ 2 ], positions[ 3 ], positions[ 0 ] );
                 }
+                return;
             }
+            const auto extent{ VecSub( centerBounds.max, centerBounds.min ) };
+            const int axis{ extent[ 0 ] >= extent[ 1 ] && extent[ 0 ] >= extent[ 2 ] ? 0 : ( extent[ 1 ] >= extent[ 2 ] ? 1 : 2 ) };
+            const auto half{ _count / 2 };
+            std::nth_element( itFirst, itFirst + half, itLast, [ & ]( const unsigned _a, const unsigned _b ) {
+                    return centers[ _a ][ axis ] < centers[ _b ][ axis ];
+                } );
+            const auto left{ static_cast< unsigned >( tree.nodes.size() ) };
+            tree.nodes.resize( tree.nodes.size() + 2 );
+            tree.nodes[ _nodeIndex ].first = left;
+            tree.nodes[ _nodeIndex ].count = 0;
+            _Build( _Build, left, _first, half );
+            _Build( _Build, left + 1, _first + half, _count - half );
+        } };
+    tree.nodes.resize( 1 );
+    Build( Build, 0, 0, static_cast< unsigned >( _quads.size() ) );
+    return tree;
+}
 
-            Progress();
-        } );
+// occluders: the coplanar plates of a same normal and size merged into maximal rectangles (greedy meshing), the occlusion test
+// only needing the surfaces while the plates stay the lightmap receivers, every plate being mapped to the occluder covering it:
+Quads MergeOccluders( const Plates & _plates, std::vector< unsigned > & _plateOccluders )
+{
+    Quads occluders;
+    _plateOccluders.assign( _plates.size(), 0 );
+    const auto AddOccluder{ [ & ]( const Quad & _positions ) {
+            occluders.emplace_back( _positions );
+            return static_cast< unsigned >( occluders.size() - 1 );
+        } };
 
-        // convert emitters to photons:
-        photons.clear();
-        for( auto & plate : plates ) {
-            for( auto & emitter : plate.emitters ) {
-                const auto color{ VecMult( emitter.color, lightResolution ) };
-                if( color[ 0 ] > epsilon && color[ 1 ] > epsilon && color[ 2 ] > epsilon ) {
-                    // slightly move the photon above the plate
-                    static constexpr Real shift{ 0.0000001 };
-                    const auto position{ VecAdd( emitter.position, VecMult( plate.normal, shift ) ) };
-                    photons.emplace_back( Photon{ position, plate.normal, color } );
-                }
-                emitter.color = Vector3D{ 0, 0, 0 }; // reset for next round
+    // axis-aligned plates grouped by normal, plane and size, the others being occluders on their own:
+    using PlaneKey = std::tuple< Real, Real, Real, Real, Real, Real >;
+    std::map< PlaneKey, std::vector< unsigned > > planes;
+    const auto PlaneAxes{ []( const Vector3D & _normal ) {
+            const int axis{ _normal[ 0 ] != 0 ? 0 : ( _normal[ 1 ] != 0 ? 1 : 2 ) };
+            return std::array< int, 3 >{ axis, ( axis + 1 ) % 3, ( axis + 2 ) % 3 };
+        } };
+    for( unsigned plateIndex{ 0 }; plateIndex < _plates.size(); ++plateIndex ) {
+        const auto & plate{ _plates[ plateIndex ] };
+        const auto & normal{ plate.normal };
+        const auto [ axis, u, v ]{ PlaneAxes( normal ) };
+        auto min{ plate.positions[ 0 ] };
+        auto max{ plate.positions[ 0 ] };
+        for( const auto & position : plate.positions ) {
+            for( int i{ 0 }; i < 3; ++i ) {
+                min[ i ] = std::min( min[ i ], position[ i ] );
+                max[ i ] = std::max( max[ i ], position[ i ] );
             }
         }
+        const bool axisAligned{ normal[ u ] == 0 && normal[ v ] == 0 && min[ axis ] == max[ axis ] && max[ u ] > min[ u ] && max[ v ] > min[ v ] };
+        if( axisAligned )
+            planes[ { normal[ 0 ], normal[ 1 ], normal[ 2 ], min[ axis ], max[ u ] - min[ u ], max[ v ] - min[ v ] } ].emplace_back( plateIndex );
+        else
+            _plateOccluders[ plateIndex ] = AddOccluder( plate.positions );
     }
 
-    // computation duration:
-    const auto duration{ std::chrono::high_resolution_clock::now() - t0 };
-    const auto minutes { std::chrono::duration_cast< std::chrono::minutes >( duration ) };
-    const auto seconds { std::chrono::duration_cast< std::chrono::seconds >( duration - minutes ) };
-    const auto milliseconds { std::chrono::duration_cast< std::chrono::milliseconds >( duration - minutes - seconds ) };
-    std::cout << "computation duration: " << minutes.count() << "m " << seconds.count() << "s " << milliseconds.count() << "ms" << std::endl;
-
-    // convert received power values as RGB texture:
-    std::for_each( std::execution::par_unseq, plates.begin(), plates.end(), [ & ]( auto & _plate ) {
-        _plate.colors.resize( scene.textureWidth * scene.textureWidth );
-        auto itColor{ _plate.colors.begin() };
-        for( const auto receiver : _plate.receivers ) {
-            const auto colorR{ static_cast< unsigned char >( std::clamp< Real >( receiver[ 0 ] / realMultiplier, 0, 1 ) * 255 ) };
-            const auto colorG{ static_cast< unsigned char >( std::clamp< Real >( receiver[ 1 ] / realMultiplier, 0, 1 ) * 255 ) };
-            const auto colorB{ static_cast< unsigned char >( std::clamp< Real >( receiver[ 2 ] / realMultiplier, 0, 1 ) * 255 ) };
-            *itColor++ = { colorR, colorG, colorB };
+    // plates of a plane laid out on its grid, each rectangle growing along u then along v from the first cell left:
+    for( const auto & [ key, plateIndices ] : planes ) {
+        const auto & firstPlate{ _plates[ plateIndices.front() ] };
+        const auto [ axis, u, v ]{ PlaneAxes( firstPlate.normal ) };
+        const auto cellWidth{ std::get< 4 >( key ) };
+        const auto cellHeight{ std::get< 5 >( key ) };
+        const auto PlateMin{ [ & ]( const unsigned _plate, const int _axis ) {
+                const auto & positions{ _plates[ _plate ].positions };
+                return std::min( { positions[ 0 ][ _axis ], positions[ 1 ][ _axis ], positions[ 2 ][ _axis ], positions[ 3 ][ _axis ] } );
+            } };
+        const auto PlateMax{ [ & ]( const unsigned _plate, const int _axis ) {
+                const auto & positions{ _plates[ _plate ].positions };
+                return std::max( { positions[ 0 ][ _axis ], positions[ 1 ][ _axis ], positions[ 2 ][ _axis ], positions[ 3 ][ _axis ] } );
+            } };
+        Real originU{ std::numeric_limits< Real >::max() };
+        Real originV{ std::numeric_limits< Real >::max() };
+        for( const auto plateIndex : plateIndices ) {
+            originU = std::min( originU, PlateMin( plateIndex, u ) );
+            originV = std::min( originV, PlateMin( plateIndex, v ) );
         }
-    } );
+        std::map< std::pair< long long, long long >, std::pair< unsigned, bool > > cells; // (v, u) cell: plate, merged
+        for( const auto plateIndex : plateIndices )
+            cells[ { std::llround( ( PlateMin( plateIndex, v ) - originV ) / cellHeight ), std::llround( ( PlateMin( plateIndex, u ) - originU ) / cellWidth ) } ] = { plateIndex, false };
+        const auto Free{ [ & ]( const long long _v, const long long _u ) {
+                const auto itCell{ cells.find( { _v, _u } ) };
+                return itCell != cells.end() && !itCell->second.second;
+            } };
+        for( auto & [ cell, start ] : cells ) {
+            if( start.second )
+                continue;
+            const auto [ v0, u0 ]{ cell };
+            auto u1{ u0 };
+            while( Free( v0, u1 + 1 ) )
+                ++u1;
+            auto v1{ v0 };
+            for( ; ; ++v1 ) {
+                bool rowFree{ true };
+                for( auto cellU{ u0 }; cellU <= u1 && rowFree; ++cellU )
+                    rowFree = Free( v1 + 1, cellU );
+                if( !rowFree )
+                    break;
+            }
 
-    // prepare 3D data for rendering:
-    std::vector< float > vertices;
-    std::vector< unsigned int > indices;
-    const std::array< unsigned int, 6 > plateIndices{ 0, 1, 2, 2, 3, 0 };
-    unsigned int offset{ 0 };
-    for( const auto & plate : plates ) {
-        for( int i{ 0 }; i < 4; ++i ) {
-            for( const auto value : plate.positions[ i ] )
-                vertices.emplace_back( static_cast< float >( value ) );
-            for( const auto value : plate.textures[ i ] )
-                vertices.emplace_back( static_cast< float >( value ) );
+            // corners taken from the corner plates, so that the rectangle edges are the plate edges:
+            const auto minU{ PlateMin( start.first, u ) };
+            const auto minV{ PlateMin( start.first, v ) };
+            const auto maxU{ PlateMax( cells[ { v0, u1 } ].first, u ) };
+            const auto maxV{ PlateMax( cells[ { v1, u0 } ].first, v ) };
+            Quad positions;
+            for( auto & position : positions )
+                position[ axis ] = std::get< 3 >( key );
+            positions[ 0 ][ u ] = minU; positions[ 0 ][ v ] = minV;
+            positions[ 1 ][ u ] = maxU; positions[ 1 ][ v ] = minV;
+            positions[ 2 ][ u ] = maxU; positions[ 2 ][ v ] = maxV;
+            positions[ 3 ][ u ] = minU; positions[ 3 ][ v ] = maxV;
+            const auto occluder{ AddOccluder( positions ) };
+            for( auto cellV{ v0 }; cellV <= v1; ++cellV ) {
+                for( auto cellU{ u0 }; cellU <= u1; ++cellU ) {
+                    auto & merged{ cells[ { cellV, cellU } ] };
+                    merged.second = true;
+                    _plateOccluders[ merged.first ] = occluder;
+                }
+            }
         }
-        for( const auto i : plateIndices )
-            indices.emplace_back( offset + i );
-        offset += 4;
     }
+    return occluders;
+}
 
-    if( !::glfwInit() ) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
-        return -1;
+inline static bool SegmentIntersectsBounds( const Vector3D & _p0, const Vector3D & _dir, const Bounds & _bounds )
+{
+    Real tMin{ 0 };
+    Real tMax{ 1 };
+    for( int i{ 0 }; i < 3; ++i ) {
+        if( _dir[ i ] == 0 ) {
+            if( _p0[ i ] < _bounds.min[ i ] || _p0[ i ] > _bounds.max[ i ] )
+                return false;
+            continue;
+        }
+        const auto invDir{ Real{ 1 } / _dir[ i ] };
+        auto t0{ ( _bounds.min[ i ] - _p0[ i ] ) * invDir };
+        auto t1{ ( _bounds.max[ i ] - _p0[ i ] ) * invDir };
+        if( t0 > t1 )
+            std::swap( t0, t1 );
+        tMin = std::max( tMin, t0 );
+        tMax = std::min( tMax, t1 );
+        if( tMin > tMax )
+            return false;
     }
+    return true;
+}
 
-    ::glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 3 );
-    ::glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
-    ::glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
-
-    const int screenWidth{ 1600 };
-    const int screenHeight{ 1200 };
+// same answer as SegmentOccludedBruteForce, only the plates whose bounds are crossed by the segment are tested,
+// either plate by plate or as one packet test of the leaf occluder block:
+inline static bool SegmentOccluded( const OcclusionTree & _tree, const Quads & _quads, const BlockIntersection _BlockIntersection,
+    const Vector3D & _p0, const Vector3D & _p1, const std::size_t _skippedPlate, std::uint64_t & _triangleCount )
+{
+    if( _tree.nodes.empty() )
+        return false;
+    const auto dir{ VecSub( _p1, _p0 ) };
+    std::array< unsigned, 64 > stack;
+    unsigned stackSize{ 0 };
+    stack[ stackSize++ ] = 0;
+    while( stackSize != 0 ) {
+        const auto & node{ _tree.nodes[ stack[ --stackSize ] ] };
+        if( !SegmentIntersectsBounds( _p0, dir, node.bounds ) )
+            continue;
+        if( node.count == 0 ) {
+            stack[ stackSize++ ] = node.first;
+            stack[ stackSize++ ] = node.first + 1;
+            continue;
+        }
+        _triangleCount += 2 * node.count;
+        if( _BlockIntersection != nullptr ) {
+            if( _BlockIntersection( _tree.blocks[ node.block ], _p0, dir, _skippedPlate ) )
+                return true;
+            continue;
+        }
+        for( unsigned i{ node.first }; i < node.first + node.count; ++i ) {
+            const auto plateIndex{ _tree.plateIndices[ i ] };
+            if( plateIndex != _skippedPlate && SegmentIntersectsPlate( _p0, _p1, _quads[ plateIndex ] ) )
+                return true; // early exit, any hit is enough
+        }
+    }
+    return false;
+}
 
-    GLFWwindow * const pWindow{ ::glfwCreateWindow( screenWidth, screenHeight, "LightShot", nullptr, nullptr ) };
-    if( pWindow == nullptr ) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        ::glfwTerminate();
-        return -1;
+// plate first crossed by a segment and the segment parameter of the crossing, the nodes beyond the nearest crossing found so far
+// being skipped:
+inline static std::optional< std::pair< std::size_t, Real > > SegmentNearestPlate( const OcclusionTree & _tree, const Quads & _quads,
+    const Vector3D & _p0, const Vector3D & _p1, std::uint64_t & _triangleCount )
+{
+    std::optional< std::pair< std::size_t, Real > > nearest;
+    if( _tree.nodes.empty() )
+        return nearest;
+    const auto dir{ VecSub( _p1, _p0 ) };
+    std::array< unsigned, 64 > stack;
+    unsigned stackSize{ 0 };
+    stack[ stackSize++ ] = 0;
+    while( stackSize != 0 ) {
+        const auto & node{ _tree.nodes[ stack[ --stackSize ] ] };
+        if( !SegmentIntersectsBounds( _p0, nearest ? VecMult( dir, nearest->second ) : dir, node.bounds ) )
+            continue;
+        if( node.count == 0 ) {
+            stack[ stackSize++ ] = node.first;
+            stack[ stackSize++ ] = node.first + 1;
+            continue;
+        }
+        _triangleCount += 2 * node.count;
+        for( unsigned i{ node.first }; i < node.first + node.count; ++i ) {
+            const auto plateIndex{ _tree.plateIndices[ i ] };
+            const auto & positions{ _quads[ plateIndex ] };
+            for( const auto & t : { SegmentTriangleHit( _p0, _p1, positions[ 0 ], positions[ 1 ], positions[ 2 ] ), SegmentTriangleHit( _p0, _p1, positions[ 2 ], positions[ 3 ], positions[ 0 ] ) } )
+                if( t && ( !nearest || *t < nearest->second ) )
+                    nearest = { plateIndex, *t };
+        }
     }
+    return nearest;
+}
 
-    ::glfwMakeContextCurrent( pWindow );
-    ::glfwSetFramebufferSizeCallback( pWindow, []( GLFWwindow *, int _width, int _height ){
-            ::glViewport( 0, 0, _width, _height );
-        } );
+// hot path event counts, every worker counting into its own slot, summed once the tasks are over:
+LIGHTSHOT_PADDED_BEGIN
+struct alignas( 64 ) PassCounters
+{
+    std::uint64_t facingRejections{ 0 }; // texels whose ray does not face the photon
+    std::uint64_t occlusionTests{ 0 }; // rays
+    std::uint64_t trianglesTested{ 0 }; // by all of the rays
+    std::uint64_t raysBlocked{ 0 };
+    std::uint64_t photonsEmitted{ 0 }; // for the next pass
+    std::uint64_t photonsCulled{ 0 }; // texels which received too little energy to be emitted
+    std::uint64_t pairsCulled{ 0 }; // (receiving plate, photon) pairs skipped by the plate visibility
 
-    if( !::gladLoadGLLoader( reinterpret_cast< GLADloadproc >( ::glfwGetProcAddress ) ) ) {
-        std::cerr << "Failed to initialize GLAD" << std::endl;
-        return -1;
+    PassCounters & operator +=( const PassCounters & _counters )
+    {
+        facingRejections += _counters.facingRejections;
+        occlusionTests += _counters.occlusionTests;
+        trianglesTested += _counters.trianglesTested;
+        raysBlocked += _counters.raysBlocked;
+        photonsEmitted += _counters.photonsEmitted;
+        photonsCulled += _counters.photonsCulled;
+        pairsCulled += _counters.pairsCulled;
+        return *this;
     }
+};
+LIGHTSHOT_PADDED_END
 
-    auto vertexShader{ ::glCreateShader( GL_VERTEX_SHADER ) };
-    const char * pVertexShaderSource{ R"_(
-        #version 330 core
-        layout ( location = 0 ) in vec3 aPos;
-        layout ( location = 1 ) in vec2 aTexCoord;
-
-        out vec2 TexCoord;
+// slot of the running worker, none out of a task pool:
+static thread_local PassCounters * pThreadCounters{ nullptr };
 
-        uniform mat4 model;
-        uniform mat4 view;
-        uniform mat4 projection;
+// the receiving plate is skipped by the test, through the occluder covering it when the plates are merged, only the candidates
+// are tested when there are some, as the occluders which may lie between two plates:
+struct Occlusion
+{
+    const Quads & quads; // occluders
+    const OcclusionTree & tree;
+    bool bruteForce;
+    BlockIntersection blockIntersection; // null to test the leaf plates one by one
+    const std::vector< unsigned > * pPlateOccluders; // occluder of every plate, null when the occluders are the plates
+    std::optional< std::span< const unsigned > > candidates{};
 
-        void main()
+    bool operator ()( const Vector3D & _p0, const Vector3D & _p1, const std::size_t _skippedPlate ) const
+    {
+        const auto skippedOccluder{ pPlateOccluders != nullptr ? ( *pPlateOccluders )[ _skippedPlate ] : _skippedPlate };
+        std::uint64_t triangleCount{ 0 };
+        const auto occluded{ candidates ? std::any_of( candidates->begin(), candidates->end(), [ & ]( const unsigned _occluder ) {
+                                              triangleCount += 2;
+                                              return _occluder != skippedOccluder && SegmentIntersectsPlate( _p0, _p1, quads[ _occluder ] );
+                                          } )
+                           : bruteForce ? SegmentOccludedBruteForce( quads, _p0, _p1, skippedOccluder, triangleCount )
+                                        : SegmentOccluded( tree, quads, blockIntersection, _p0, _p1, skippedOccluder, triangleCount ) };
+        if( pThreadCounters != nullptr ) {
+            ++pThreadCounters->occlusionTests;
+            pThreadCounters->trianglesTested += triangleCount;
+            pThreadCounters->raysBlocked += occluded ? 1 : 0;
+        }
+        return occluded;
+    }
+};
+
+
+// work-stealing pool, tasks are the indices of a range: every worker starts with an even share of the range,
+// pops tasks from the front of its share and, once it runs dry, steals the back half of the largest remaining share,
+// the calling thread being the first worker:
+struct TaskPool
+{
+    LIGHTSHOT_PADDED_BEGIN
+    struct alignas( 64 ) Share
+    {
+        std::mutex mutex;
+        std::size_t first{ 0 };
+        std::size_t last{ 0 };
+    };
+    LIGHTSHOT_PADDED_END
+
+    std::vector< Share > shares;
+    std::vector< PassCounters > counters; // per worker
+    std::vector< std::thread > threads;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable done;
+    const std::function< void( std::size_t ) > * pTask{ nullptr };
+    unsigned generation{ 0 };
+    unsigned busyCount{ 0 };
+    bool stopping{ false };
+
+    explicit TaskPool( const unsigned _threadCount )
+        : shares( std::max( _threadCount, 1u ) ), counters( shares.size() )
+    {
+        for( unsigned worker{ 1 }; worker < shares.size(); ++worker )
+            threads.emplace_back( [ this, worker ]{
+                    pThreadCounters = &counters[ worker ];
+                    unsigned seenGeneration{ 0 };
+                    while( true ) {
+                        {
+                            std::unique_lock lock{ mutex };
+                            wakeUp.wait( lock, [ & ]{ return stopping || generation != seenGeneration; } );
+                            if( stopping )
+                                return;
+                            seenGeneration = generation;
+                        }
+                        Work( worker );
+                        std::lock_guard lock{ mutex };
+                        if( --busyCount == 0 )
+                            done.notify_one();
+                    }
+                } );
+    }
+
+    ~TaskPool()
+    {
+        {
+            std::lock_guard lock{ mutex };
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for( auto & thread : threads )
+            thread.join();
+    }
+
+    unsigned ThreadCount() const
+    {
+        return static_cast< unsigned >( shares.size() );
+    }
+
+    // runs the tasks of [0, _taskCount) and returns once all of them are over:
+    void Run( const std::size_t _taskCount, const std::function< void( std::size_t ) > & _Task )
+    {
+        for( std::size_t worker{ 0 }; worker < shares.size(); ++worker ) {
+            shares[ worker ].first = _taskCount * worker / shares.size();
+            shares[ worker ].last = _taskCount * ( worker + 1 ) / shares.size();
+        }
+        {
+            std::lock_guard lock{ mutex };
+            pTask = &_Task;
+            busyCount = static_cast< unsigned >( threads.size() );
+            ++generation;
+        }
+        wakeUp.notify_all();
+        auto * const pCallerCounters{ pThreadCounters };
+        pThreadCounters = &counters[ 0 ];
+        Work( 0 );
+        pThreadCounters = pCallerCounters;
+        std::unique_lock lock{ mutex };
+        done.wait( lock, [ & ]{ return busyCount == 0; } );
+    }
+
+    // sum of the worker counters since the last call, between two runs:
+    PassCounters TakeCounters()
+    {
+        PassCounters sum;
+        for( auto & workerCounters : counters ) {
+            sum += workerCounters;
+            workerCounters = {};
+        }
+        return sum;
+    }
+
+    void Work( const std::size_t _worker )
+    {
+        auto & share{ shares[ _worker ] };
+        while( true ) {
+            std::size_t task;
+            {
+                std::lock_guard lock{ share.mutex };
+                task = share.first < share.last ? share.first++ : std::numeric_limits< std::size_t >::max();
+            }
+            if( task != std::numeric_limits< std::size_t >::max() ) {
+                ( *pTask )( task );
+                continue;
+            }
+            if( !Steal( _worker ) )
+                return;
+        }
+    }
+
+    bool Steal( const std::size_t _worker )
+    {
+        while( true ) {
+            // largest share of another worker:
+            std::size_t victim{ _worker };
+            std::size_t victimSize{ 0 };
+            for( std::size_t worker{ 0 }; worker < shares.size(); ++worker ) {
+                std::lock_guard lock{ shares[ worker ].mutex };
+                const auto size{ shares[ worker ].last - shares[ worker ].first };
+                if( worker != _worker && size > victimSize ) {
+                    victim = worker;
+                    victimSize = size;
+                }
+            }
+            if( victimSize == 0 )
+                return false; // nothing left anywhere, the tasks being run will complete on their own
+            std::size_t first;
+            std::size_t last;
+            {
+                std::lock_guard lock{ shares[ victim ].mutex };
+                auto & victimShare{ shares[ victim ] };
+                if( victimShare.first == victimShare.last )
+                    continue; // emptied meanwhile, look again
+                last = victimShare.last;
+                first = victimShare.last - ( victimShare.last - victimShare.first + 1 ) / 2;
+                victimShare.last = first;
+            }
+            std::lock_guard lock{ shares[ _worker ].mutex };
+            shares[ _worker ].first = first;
+            shares[ _worker ].last = last;
+            return true;
+        }
+    }
+};
+
+
+// Chrome trace of the scoped timers (chrome://tracing or ui.perfetto.dev), timers being closed from any thread:
+struct Trace
+{
+    struct Event
+    {
+        std::string name;
+        std::chrono::high_resolution_clock::time_point begin;
+        std::chrono::high_resolution_clock::time_point end;
+        std::vector< std::pair< const char *, double > > args;
+    };
+
+    const std::chrono::high_resolution_clock::time_point origin{ std::chrono::high_resolution_clock::now() };
+    std::mutex mutex;
+    std::vector< Event > events;
+
+    void Add( Event && _event )
+    {
+        std::lock_guard lock{ mutex };
+        events.emplace_back( std::move( _event ) );
+    }
+
+    bool Write( const char * _path )
+    {
+        std::lock_guard lock{ mutex };
+        std::ofstream file{ _path, std::ios::trunc };
+        file.precision( 15 );
+        const auto Microseconds{ [ & ]( const std::chrono::high_resolution_clock::time_point _time ) {
+                return std::chrono::duration< double, std::micro >( _time - origin ).count();
+            } };
+        file << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        for( std::size_t i{ 0 }; i < events.size(); ++i ) {
+            const auto & event{ events[ i ] };
+            file << ( i == 0 ? "\n  " : ",\n  " ) << "{ \"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": " << Microseconds( event.begin )
+                 << ", \"dur\": " << Microseconds( event.end ) - Microseconds( event.begin ) << ", \"args\": {";
+            for( std::size_t j{ 0 }; j < event.args.size(); ++j )
+                file << ( j == 0 ? " " : ", " ) << "\"" << event.args[ j ].first << "\": " << event.args[ j ].second;
+            file << " } }";
+            // arguments also on a counter track:
+            if( !event.args.empty() ) {
+                file << ",\n  { \"name\": \"counters\", \"ph\": \"C\", \"pid\": 1, \"ts\": " << Microseconds( event.end ) << ", \"args\": {";
+                for( std::size_t j{ 0 }; j < event.args.size(); ++j )
+                    file << ( j == 0 ? " " : ", " ) << "\"" << event.args[ j ].first << "\": " << event.args[ j ].second;
+                file << " } }";
+            }
+        }
+        file << "\n] }\n";
+        file.close();
+        return static_cast< bool >( file );
+    }
+};
+
+// records its lifetime into the trace, if any, along with the arguments set meanwhile:
+struct ScopedTimer
+{
+    Trace * pTrace;
+    std::string name;
+    std::vector< std::pair< const char *, double > > args{};
+    const std::chrono::high_resolution_clock::time_point begin{ std::chrono::high_resolution_clock::now() };
+
+    ~ScopedTimer()
+    {
+        if( pTrace != nullptr )
+            pTrace->Add( { std::move( name ), begin, std::chrono::high_resolution_clock::now(), std::move( args ) } );
+    }
+};
+
+
+// slightly move the photon above the plate:
+inline static constexpr Real photonShift{ 0.0000001 };
+
+inline static Vector3D EmitterPhotonPosition( const Vector3D & _emitterPosition, const Vector3D & _normal )
+{
+    return VecAdd( _emitterPosition, VecMult( _normal, photonShift ) );
+}
+
+// center of a texel in 3D, in geometry precision:
+inline static Vector3D TexelPosition( const Plate & _plate, const unsigned _x, const unsigned _y, const unsigned _textureWidth )
+{
+    const auto & a{ _plate.positions[ 0 ] };
+    const auto ba{ VecSub( _plate.positions[ 1 ], a ) };
+    const auto da{ VecSub( _plate.positions[ 3 ], a ) };
+    const auto daY{ VecMult( da, ( static_cast< Real >( _y ) + Real{ 0.5 } ) / _textureWidth ) };
+    const auto baX{ VecMult( ba, ( static_cast< Real >( _x ) + Real{ 0.5 } ) / _textureWidth ) };
+    return VecAdd( VecAdd( a, baX ), daY );
+}
+
+// the engine is instantiated for the usual texture widths so that texel loops have a compile-time trip count,
+// a zero width stands for the generic runtime one:
+template< unsigned TextureWidth >
+inline static unsigned SpecializedWidth( const unsigned _textureWidth )
+{
+    if constexpr( TextureWidth != 0 )
+        return TextureWidth;
+    else
+        return _textureWidth;
+}
+
+// the texels of a plate are shot by tiles, a tile size being a multiple of every kernel lane count:
+inline static constexpr std::size_t tileSize{ 64 };
+
+inline static std::size_t TileCount( const std::size_t _texelCount )
+{
+    return ( _texelCount + tileSize - 1 ) / tileSize;
+}
+
+// accumulation target of a transport kernel: a tile of a plate, the pointers address the first texel of the tile,
+// either in the plate buffers or in private buffers of the task:
+template< typename T >
+struct TexelTarget
+{
+    std::size_t firstTexel;
+    std::size_t lastTexel;
+    std::array< T *, 3 > receivers;
+    std::array< T *, 3 > emitters;
+};
+
+template< template< typename > typename Array, typename T >
+inline static TexelTarget< T > ArrayTarget( Array< T > & _receivers, Array< T > & _emitters, const std::size_t _offset,
+    const std::size_t _firstTexel, const std::size_t _lastTexel )
+{
+    return { _firstTexel, _lastTexel, { _receivers.x.data() + _offset, _receivers.y.data() + _offset, _receivers.z.data() + _offset },
+        { _emitters.x.data() + _offset, _emitters.y.data() + _offset, _emitters.z.data() + _offset } };
+}
+
+template< typename T >
+inline static TexelTarget< T > TileTarget( Texels< T > & _texels, const std::size_t _tile )
+{
+    const auto firstTexel{ _tile * tileSize };
+    return ArrayTarget( _texels.receivers, _texels.emitters, firstTexel, firstTexel, std::min( firstTexel + tileSize, _texels.positions.x.size() ) );
+}
+
+// power of two widths fill whole tiles, so the specialized engines have a compile-time tile trip count:
+template< unsigned TextureWidth, typename T >
+inline static std::size_t TileTexelCount( const TexelTarget< T > & _target )
+{
+    if constexpr( TextureWidth != 0 )
+        return std::min( tileSize, std::size_t{ TextureWidth } * TextureWidth );
+    else
+        return _target.lastTexel - _target.firstTexel;
+}
+
+
+// scene terms of the transport, in the engine precision, occlusion is skipped without occlusion test:
+template< typename T >
+struct Transport
+{
+    const Plates & plates;
+    const Occlusion * pOcclusion;
+    unsigned textureWidth;
+    Vector3< T > wavelengthDecay;
+    T wavelengthDecayDistance;
+};
+
+template< typename T >
+inline static Transport< T > MakeTransport( const Scene & _scene, const Plates & _plates, const Occlusion * _pOcclusion )
+{
+    return { _plates, _pOcclusion, _scene.textureWidth, VecCast< T >( _scene.wavelengthDecay ), static_cast< T >( _scene.wavelengthDecayDistance ) };
+}
+
+template< typename T >
+inline static T DistanceFactor( const T _wavelengthDecayDistance, const T _distance )
+{
+    return static_cast< T >( std::pow( 1 - ( _distance < _wavelengthDecayDistance ? _distance / _wavelengthDecayDistance : 1 ), 1 ) );
+}
+
+template< typename T >
+inline static Vector3< T > WavelengthDecay( const Vector3< T > & _wavelengthDecay, const T _distanceFactor )
+{
+    return VecAdd( _wavelengthDecay, VecMult( VecSub( { 1, 1, 1 }, _wavelengthDecay ), _distanceFactor ) );
+}
+
+// occlusion always runs in geometry precision, texels are recomputed from the plate below it:
+template< typename T, unsigned TextureWidth >
+inline static Vector3D GeometryTexelPosition( const Transport< T > & _transport, const Texels< T > & _texels, const std::size_t _plateIndex, const std::size_t _texel )
+{
+    if constexpr( std::is_same_v< T, Real > )
+        return VecArrayGet( _texels.positions, _texel );
+    else {
+        const auto width{ SpecializedWidth< TextureWidth >( _texels.width ) };
+        return TexelPosition( _transport.plates[ _plateIndex ], static_cast< unsigned >( _texel % width ), static_cast< unsigned >( _texel / width ), width );
+    }
+}
+
+
+// transport kernels, shooting one photon at a tile of the texels of a plate:
+template< typename T >
+using TransportKernel = void ( * )( const Transport< T > &, const Texels< T > &, std::size_t, const Photon< T > &, const TexelTarget< T > & );
+
+template< typename T, unsigned TextureWidth >
+inline static void ShootPhotonScalar( const Transport< T > & _transport, const Texels< T > & _texels, const std::size_t _plateIndex,
+    const Photon< T > & _photon, const TexelTarget< T > & _target, const std::size_t _firstTexel, const std::size_t _lastTexel )
+{
+    const auto & material{ _transport.plates[ _plateIndex ].material };
+    const auto materialColor{ VecCast< T >( material.color ) };
+    const auto retransmission{ static_cast< T >( material.retransmission ) };
+    const auto photonPosition{ VecCast< T >( _photon.position ) };
+    std::uint64_t facingRejections{ 0 };
+    for( std::size_t texel{ _firstTexel }; texel < _lastTexel; ++texel ) {
+        const auto position{ VecArrayGet( _texels.positions, texel ) };
+
+        const auto rayNormal{ VecNorm( VecSub( photonPosition, position ) ) };
+        if( !VecFacing( rayNormal, _photon.normal ) ) {
+            ++facingRejections;
+            continue; // the normal of the ray is not facing the photon ray
+        }
+
+        // intersections with other plates:
+        if( _transport.pOcclusion != nullptr && ( *_transport.pOcclusion )( GeometryTexelPosition< T, TextureWidth >( _transport, _texels, _plateIndex, texel ), _photon.position, _plateIndex ) )
+            continue; // ray intersects with something
+
+        // distance:
+        const auto distance{ VecDist( photonPosition, position ) };
+        const auto wavelengthDecay{ WavelengthDecay( _transport.wavelengthDecay, DistanceFactor( _transport.wavelengthDecayDistance, distance ) ) };
+
+        // compute received power value:
+        const auto raySrcAngle{ -VecDot( _photon.normal, rayNormal ) };
+        const auto received{ VecMult( VecMult( VecMult( _photon.color, materialColor ), wavelengthDecay ), raySrcAngle ) };
+        const auto slot{ texel - _target.firstTexel };
+        for( int i{ 0 }; i < 3; ++i ) {
+            _target.receivers[ i ][ slot ] += received[ i ];
+            _target.emitters[ i ][ slot ] += received[ i ] * retransmission; // cumulated energy transmission
+        }
+    }
+    if( pThreadCounters != nullptr )
+        pThreadCounters->facingRejections += facingRejections;
+}
+
+template< typename T, unsigned TextureWidth >
+void ShootPhotonScalar( const Transport< T > & _transport, const Texels< T > & _texels, const std::size_t _plateIndex, const Photon< T > & _photon, const TexelTarget< T > & _target )
+{
+    ShootPhotonScalar< T, TextureWidth >( _transport, _texels, _plateIndex, _photon, _target, _target.firstTexel, _target.firstTexel + TileTexelCount< TextureWidth >( _target ) );
+}
+
+// the vector kernels perform the very same operations in the very same order as the scalar one, lane by lane,
+// while the occlusion test stays scalar and is only run for the lanes facing the photon,
+// the overloads below let a single kernel body run on float or double lanes:
+#if defined( LIGHTSHOT_X86 )
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256 Avx2Set( const float _value ) { return _mm256_set1_ps( _value ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256d Avx2Set( const double _value ) { return _mm256_set1_pd( _value ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256 Avx2Load( const float * _p ) { return _mm256_loadu_ps( _p ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256d Avx2Load( const double * _p ) { return _mm256_loadu_pd( _p ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static void Avx2Store( float * _p, const __m256 _a ) { _mm256_storeu_ps( _p, _a ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static void Avx2Store( double * _p, const __m256d _a ) { _mm256_storeu_pd( _p, _a ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256 Avx2Add( const __m256 _a, const __m256 _b ) { return _mm256_add_ps( _a, _b ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256d Avx2Add( const __m256d _a, const __m256d _b ) { return _mm256_add_pd( _a, _b ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256 Avx2Sub( const __m256 _a, const __m256 _b ) { return _mm256_sub_ps( _a, _b ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256d Avx2Sub( const __m256d _a, const __m256d _b ) { return _mm256_sub_pd( _a, _b ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256 Avx2Mul( const __m256 _a, const __m256 _b ) { return _mm256_mul_ps( _a, _b ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256d Avx2Mul( const __m256d _a, const __m256d _b ) { return _mm256_mul_pd( _a, _b ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256 Avx2Div( const __m256 _a, const __m256 _b ) { return _mm256_div_ps( _a, _b ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256d Avx2Div( const __m256d _a, const __m256d _b ) { return _mm256_div_pd( _a, _b ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256 Avx2Sqrt( const __m256 _a ) { return _mm256_sqrt_ps( _a ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256d Avx2Sqrt( const __m256d _a ) { return _mm256_sqrt_pd( _a ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256 Avx2Less( const __m256 _a, const __m256 _b ) { return _mm256_cmp_ps( _a, _b, _CMP_LT_OQ ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256d Avx2Less( const __m256d _a, const __m256d _b ) { return _mm256_cmp_pd( _a, _b, _CMP_LT_OQ ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static int Avx2LessEqualBits( const __m256 _a, const __m256 _b ) { return _mm256_movemask_ps( _mm256_cmp_ps( _a, _b, _CMP_LE_OQ ) ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static int Avx2LessEqualBits( const __m256d _a, const __m256d _b ) { return _mm256_movemask_pd( _mm256_cmp_pd( _a, _b, _CMP_LE_OQ ) ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256 Avx2Blend( const __m256 _a, const __m256 _b, const __m256 _mask ) { return _mm256_blendv_ps( _a, _b, _mask ); }
+LIGHTSHOT_TARGET( "avx2" ) inline static __m256d Avx2Blend( const __m256d _a, const __m256d _b, const __m256d _mask ) { return _mm256_blendv_pd( _a, _b, _mask ); }
+
+// lane mask out of the lane bits:
+template< typename T >
+LIGHTSHOT_TARGET( "avx2" )
+inline static auto Avx2Mask( const int _bits )
+{
+    if constexpr( std::is_same_v< T, float > ) {
+        const auto laneBits{ _mm256_set_epi32( 128, 64, 32, 16, 8, 4, 2, 1 ) };
+        return _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256( _mm256_set1_epi32( _bits ), laneBits ), laneBits ) );
+    }
+    else {
+        const auto laneBits{ _mm256_set_epi64x( 8, 4, 2, 1 ) };
+        return _mm256_castsi256_pd( _mm256_cmpeq_epi64( _mm256_and_si256( _mm256_set1_epi64x( _bits ), laneBits ), laneBits ) );
+    }
+}
+
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512 Avx512Set( const float _value ) { return _mm512_set1_ps( _value ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512d Avx512Set( const double _value ) { return _mm512_set1_pd( _value ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512 Avx512Load( const float * _p ) { return _mm512_loadu_ps( _p ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512d Avx512Load( const double * _p ) { return _mm512_loadu_pd( _p ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static void Avx512Store( float * _p, const __m512 _a ) { _mm512_storeu_ps( _p, _a ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static void Avx512Store( double * _p, const __m512d _a ) { _mm512_storeu_pd( _p, _a ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512 Avx512Add( const __m512 _a, const __m512 _b ) { return _mm512_add_ps( _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512d Avx512Add( const __m512d _a, const __m512d _b ) { return _mm512_add_pd( _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512 Avx512Sub( const __m512 _a, const __m512 _b ) { return _mm512_sub_ps( _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512d Avx512Sub( const __m512d _a, const __m512d _b ) { return _mm512_sub_pd( _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512 Avx512Mul( const __m512 _a, const __m512 _b ) { return _mm512_mul_ps( _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512d Avx512Mul( const __m512d _a, const __m512d _b ) { return _mm512_mul_pd( _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512 Avx512Div( const __m512 _a, const __m512 _b ) { return _mm512_div_ps( _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512d Avx512Div( const __m512d _a, const __m512d _b ) { return _mm512_div_pd( _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512 Avx512Sqrt( const __m512 _a ) { return _mm512_sqrt_ps( _a ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512d Avx512Sqrt( const __m512d _a ) { return _mm512_sqrt_pd( _a ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static unsigned Avx512LessBits( const __m512 _a, const __m512 _b ) { return _mm512_cmp_ps_mask( _a, _b, _CMP_LT_OQ ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static unsigned Avx512LessBits( const __m512d _a, const __m512d _b ) { return _mm512_cmp_pd_mask( _a, _b, _CMP_LT_OQ ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static unsigned Avx512LessEqualBits( const __m512 _a, const __m512 _b ) { return _mm512_cmp_ps_mask( _a, _b, _CMP_LE_OQ ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static unsigned Avx512LessEqualBits( const __m512d _a, const __m512d _b ) { return _mm512_cmp_pd_mask( _a, _b, _CMP_LE_OQ ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512 Avx512MaskAdd( const __m512 _src, const unsigned _bits, const __m512 _a, const __m512 _b ) { return _mm512_mask_add_ps( _src, static_cast< __mmask16 >( _bits ), _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512d Avx512MaskAdd( const __m512d _src, const unsigned _bits, const __m512d _a, const __m512d _b ) { return _mm512_mask_add_pd( _src, static_cast< __mmask8 >( _bits ), _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512 Avx512MaskDiv( const __m512 _src, const unsigned _bits, const __m512 _a, const __m512 _b ) { return _mm512_mask_div_ps( _src, static_cast< __mmask16 >( _bits ), _a, _b ); }
+LIGHTSHOT_TARGET( "avx512f" ) inline static __m512d Avx512MaskDiv( const __m512d _src, const unsigned _bits, const __m512d _a, const __m512d _b ) { return _mm512_mask_div_pd( _src, static_cast< __mmask8 >( _bits ), _a, _b ); }
+
+template< typename T, unsigned TextureWidth >
+LIGHTSHOT_TARGET( "avx2" )
+void ShootPhotonAvx2( const Transport< T > & _transport, const Texels< T > & _texels, const std::size_t _plateIndex, const Photon< T > & _photon, const TexelTarget< T > & _target )
+{
+    constexpr std::size_t lanes{ 32 / sizeof( T ) };
+    const auto texelCount{ TileTexelCount< TextureWidth >( _target ) };
+    const auto blockEnd{ _target.firstTexel + texelCount - texelCount % lanes };
+    const auto & material{ _transport.plates[ _plateIndex ].material };
+    const auto photonX{ Avx2Set( static_cast< T >( _photon.position[ 0 ] ) ) };
+    const auto photonY{ Avx2Set( static_cast< T >( _photon.position[ 1 ] ) ) };
+    const auto photonZ{ Avx2Set( static_cast< T >( _photon.position[ 2 ] ) ) };
+    const auto normalX{ Avx2Set( _photon.normal[ 0 ] ) };
+    const auto normalY{ Avx2Set( _photon.normal[ 1 ] ) };
+    const auto normalZ{ Avx2Set( _photon.normal[ 2 ] ) };
+    const auto photonColor{ VecMult( _photon.color, VecCast< T >( material.color ) ) };
+    const auto oneMinusDecay{ VecSub( { 1, 1, 1 }, _transport.wavelengthDecay ) };
+    const auto one{ Avx2Set( T{ 1 } ) };
+    const auto zero{ Avx2Set( T{ 0 } ) };
+    const auto decayDistance{ Avx2Set( _transport.wavelengthDecayDistance ) };
+    const auto retransmission{ Avx2Set( static_cast< T >( material.retransmission ) ) };
+    std::uint64_t facingRejections{ 0 };
+    for( std::size_t texel{ _target.firstTexel }; texel < blockEnd; texel += lanes ) {
+        const auto x{ Avx2Load( _texels.positions.x.data() + texel ) };
+        const auto y{ Avx2Load( _texels.positions.y.data() + texel ) };
+        const auto z{ Avx2Load( _texels.positions.z.data() + texel ) };
+        const auto dx{ Avx2Sub( photonX, x ) };
+        const auto dy{ Avx2Sub( photonY, y ) };
+        const auto dz{ Avx2Sub( photonZ, z ) };
+        const auto distance{ Avx2Sqrt( Avx2Add( Avx2Add( Avx2Mul( dx, dx ), Avx2Mul( dy, dy ) ), Avx2Mul( dz, dz ) ) ) };
+        const auto invDistance{ Avx2Div( one, distance ) };
+        const auto rx{ Avx2Mul( dx, invDistance ) };
+        const auto ry{ Avx2Mul( dy, invDistance ) };
+        const auto rz{ Avx2Mul( dz, invDistance ) };
+        const auto dot{ Avx2Add( Avx2Add( Avx2Mul( rx, normalX ), Avx2Mul( ry, normalY ) ), Avx2Mul( rz, normalZ ) ) };
+        auto mask{ Avx2LessEqualBits( dot, zero ) };
+        facingRejections += lanes - static_cast< std::size_t >( std::popcount( static_cast< unsigned >( mask ) ) );
+        if( _transport.pOcclusion != nullptr ) {
+            for( std::size_t lane{ 0 }; lane < lanes; ++lane )
+                if( ( mask & ( 1 << lane ) ) != 0 && ( *_transport.pOcclusion )( GeometryTexelPosition< T, TextureWidth >( _transport, _texels, _plateIndex, texel + lane ), _photon.position, _plateIndex ) )
+                    mask &= ~( 1 << lane );
+        }
+        if( mask == 0 )
+            continue;
+        const auto laneMask{ Avx2Mask< T >( mask ) };
+        const auto ratio{ Avx2Blend( one, Avx2Div( distance, decayDistance ), Avx2Less( distance, decayDistance ) ) };
+        const auto distanceFactor{ Avx2Sub( one, ratio ) };
+        const auto raySrcAngle{ Avx2Sub( zero, dot ) };
+        for( int i{ 0 }; i < 3; ++i ) {
+            const auto wavelengthDecay{ Avx2Add( Avx2Set( _transport.wavelengthDecay[ i ] ), Avx2Mul( Avx2Set( oneMinusDecay[ i ] ), distanceFactor ) ) };
+            const auto received{ Avx2Mul( Avx2Mul( Avx2Set( photonColor[ i ] ), wavelengthDecay ), raySrcAngle ) };
+            const auto pReceiver{ _target.receivers[ i ] + ( texel - _target.firstTexel ) };
+            const auto pEmitter{ _target.emitters[ i ] + ( texel - _target.firstTexel ) };
+            const auto receiver{ Avx2Load( pReceiver ) };
+            const auto emitter{ Avx2Load( pEmitter ) };
+            Avx2Store( pReceiver, Avx2Blend( receiver, Avx2Add( receiver, received ), laneMask ) );
+            Avx2Store( pEmitter, Avx2Blend( emitter, Avx2Add( emitter, Avx2Mul( received, retransmission ) ), laneMask ) );
+        }
+    }
+    if( pThreadCounters != nullptr )
+        pThreadCounters->facingRejections += facingRejections;
+    ShootPhotonScalar< T, TextureWidth >( _transport, _texels, _plateIndex, _photon, _target, blockEnd, _target.firstTexel + texelCount );
+}
+
+template< typename T, unsigned TextureWidth >
+LIGHTSHOT_TARGET( "avx512f" )
+void ShootPhotonAvx512( const Transport< T > & _transport, const Texels< T > & _texels, const std::size_t _plateIndex, const Photon< T > & _photon, const TexelTarget< T > & _target )
+{
+    constexpr std::size_t lanes{ 64 / sizeof( T ) };
+    const auto texelCount{ TileTexelCount< TextureWidth >( _target ) };
+    const auto blockEnd{ _target.firstTexel + texelCount - texelCount % lanes };
+    const auto & material{ _transport.plates[ _plateIndex ].material };
+    const auto photonX{ Avx512Set( static_cast< T >( _photon.position[ 0 ] ) ) };
+    const auto photonY{ Avx512Set( static_cast< T >( _photon.position[ 1 ] ) ) };
+    const auto photonZ{ Avx512Set( static_cast< T >( _photon.position[ 2 ] ) ) };
+    const auto normalX{ Avx512Set( _photon.normal[ 0 ] ) };
+    const auto normalY{ Avx512Set( _photon.normal[ 1 ] ) };
+    const auto normalZ{ Avx512Set( _photon.normal[ 2 ] ) };
+    const auto photonColor{ VecMult( _photon.color, VecCast< T >( material.color ) ) };
+    const auto oneMinusDecay{ VecSub( { 1, 1, 1 }, _transport.wavelengthDecay ) };
+    const auto one{ Avx512Set( T{ 1 } ) };
+    const auto zero{ Avx512Set( T{ 0 } ) };
+    const auto decayDistance{ Avx512Set( _transport.wavelengthDecayDistance ) };
+    const auto retransmission{ Avx512Set( static_cast< T >( material.retransmission ) ) };
+    std::uint64_t facingRejections{ 0 };
+    for( std::size_t texel{ _target.firstTexel }; texel < blockEnd; texel += lanes ) {
+        const auto x{ Avx512Load( _texels.positions.x.data() + texel ) };
+        const auto y{ Avx512Load( _texels.positions.y.data() + texel ) };
+        const auto z{ Avx512Load( _texels.positions.z.data() + texel ) };
+        const auto dx{ Avx512Sub( photonX, x ) };
+        const auto dy{ Avx512Sub( photonY, y ) };
+        const auto dz{ Avx512Sub( photonZ, z ) };
+        const auto distance{ Avx512Sqrt( Avx512Add( Avx512Add( Avx512Mul( dx, dx ), Avx512Mul( dy, dy ) ), Avx512Mul( dz, dz ) ) ) };
+        const auto invDistance{ Avx512Div( one, distance ) };
+        const auto rx{ Avx512Mul( dx, invDistance ) };
+        const auto ry{ Avx512Mul( dy, invDistance ) };
+        const auto rz{ Avx512Mul( dz, invDistance ) };
+        const auto dot{ Avx512Add( Avx512Add( Avx512Mul( rx, normalX ), Avx512Mul( ry, normalY ) ), Avx512Mul( rz, normalZ ) ) };
+        auto mask{ Avx512LessEqualBits( dot, zero ) };
+        facingRejections += lanes - static_cast< std::size_t >( std::popcount( static_cast< unsigned >( mask ) ) );
+        if( _transport.pOcclusion != nullptr ) {
+            for( std::size_t lane{ 0 }; lane < lanes; ++lane )
+                if( ( mask & ( 1u << lane ) ) != 0 && ( *_transport.pOcclusion )( GeometryTexelPosition< T, TextureWidth >( _transport, _texels, _plateIndex, texel + lane ), _photon.position, _plateIndex ) )
+                    mask &= ~( 1u << lane );
+        }
+        if( mask == 0 )
+            continue;
+        const auto ratio{ Avx512MaskDiv( one, Avx512LessBits( distance, decayDistance ), distance, decayDistance ) };
+        const auto distanceFactor{ Avx512Sub( one, ratio ) };
+        const auto raySrcAngle{ Avx512Sub( zero, dot ) };
+        for( int i{ 0 }; i < 3; ++i ) {
+            const auto wavelengthDecay{ Avx512Add( Avx512Set( _transport.wavelengthDecay[ i ] ), Avx512Mul( Avx512Set( oneMinusDecay[ i ] ), distanceFactor ) ) };
+            const auto received{ Avx512Mul( Avx512Mul( Avx512Set( photonColor[ i ] ), wavelengthDecay ), raySrcAngle ) };
+            const auto pReceiver{ _target.receivers[ i ] + ( texel - _target.firstTexel ) };
+            const auto pEmitter{ _target.emitters[ i ] + ( texel - _target.firstTexel ) };
+            const auto receiver{ Avx512Load( pReceiver ) };
+            const auto emitter{ Avx512Load( pEmitter ) };
+            Avx512Store( pReceiver, Avx512MaskAdd( receiver, mask, receiver, received ) );
+            Avx512Store( pEmitter, Avx512MaskAdd( emitter, mask, emitter, Avx512Mul( received, retransmission ) ) );
+        }
+    }
+    if( pThreadCounters != nullptr )
+        pThreadCounters->facingRejections += facingRejections;
+    ShootPhotonScalar< T, TextureWidth >( _transport, _texels, _plateIndex, _photon, _target, blockEnd, _target.firstTexel + texelCount );
+}
+#endif
+
+template< typename T, unsigned TextureWidth >
+TransportKernel< T > SelectTransportKernel( const KernelIsa _isa )
+{
+#if defined( LIGHTSHOT_X86 )
+    if( _isa == KernelIsa::avx512 )
+        return ShootPhotonAvx512< T, TextureWidth >;
+    if( _isa == KernelIsa::avx2 )
+        return ShootPhotonAvx2< T, TextureWidth >;
+#endif
+    return ShootPhotonScalar< T, TextureWidth >;
+}
+
+
+// plate-to-plate potentially visible set, for the photons sitting on emitter texels: a receiving plate lying behind the photon plane
+// of a source plate, or whose every segment to it crosses one same occluder, receives nothing from its photons, and the rays of a pair
+// are only tested against the occluders which may lie between the two plates, none at all for most of the pairs, all of the tests
+// keeping a margin over the rounding of the texel loops:
+enum class PlateVisibility : std::uint8_t
+{
+    culled,
+    unoccluded,
+    partial // rays tested against the occluders of the pair
+};
+
+// receiving plates [ first, last ), the plate shard of a worker process in the sharded solve, every plate otherwise:
+struct PlateRange
+{
+    std::size_t first;
+    std::size_t last;
+
+    std::size_t size() const { return last - first; }
+};
+
+struct PlateVisibilitySet
+{
+    // pairs of a receiving plate, by source plate:
+    struct Row
+    {
+        std::vector< PlateVisibility > pairs;
+        std::vector< std::uint32_t > firstOccluders; // occluders of source plate i being [ firstOccluders[ i ], firstOccluders[ i + 1 ] )
+        std::vector< unsigned > occluders;
+    };
+    std::vector< Row > rows; // empty out of the receiving plates
+
+    PlateVisibility operator ()( const std::size_t _plateIndex, const std::size_t _sourcePlate ) const
+    {
+        return rows[ _plateIndex ].pairs[ _sourcePlate ];
+    }
+
+    std::span< const unsigned > Occluders( const std::size_t _plateIndex, const std::size_t _sourcePlate ) const
+    {
+        const auto & row{ rows[ _plateIndex ] };
+        return std::span< const unsigned >{ row.occluders }.subspan( row.firstOccluders[ _sourcePlate ], row.firstOccluders[ _sourcePlate + 1 ] - row.firstOccluders[ _sourcePlate ] );
+    }
+};
+
+// one byte and one offset per plate pair, the rays of a pair with more candidate occluders being tested against the whole tree:
+inline static constexpr std::size_t maxVisibilityPlates{ 4096 };
+inline static constexpr std::size_t maxPairOccluders{ 64 };
+
+// points beyond the margin over a plane, along its normal, cannot be crossed by the rays of a plate pair:
+struct HalfSpace
+{
+    Vector3D normal;
+    Real offset;
+    Real margin;
+
+    bool Beyond( const Quad & _quad ) const
+    {
+        return std::all_of( _quad.begin(), _quad.end(), [ & ]( const Vector3D & _position ) { return VecDot( normal, _position ) - offset > margin; } );
+    }
+
+    bool Beyond( const Bounds & _bounds ) const
+    {
+        Real height{ -offset };
+        for( int i{ 0 }; i < 3; ++i )
+            height += normal[ i ] * ( normal[ i ] > 0 ? _bounds.min[ i ] : _bounds.max[ i ] );
+        return height > margin;
+    }
+};
+
+// occluders of the tree whose bounds overlap the given ones, beyond none of the half spaces and accepted by the predicate:
+template< typename Predicate >
+inline static void CollectOccluders( const OcclusionTree & _tree, const Quads & _quads, const Bounds & _bounds, const std::vector< HalfSpace > & _halfSpaces,
+    const Predicate & _Predicate, std::vector< unsigned > & _occluders )
+{
+    if( _tree.nodes.empty() )
+        return;
+    const auto Outside{ [ & ]( const auto & _shape ) {
+            return std::any_of( _halfSpaces.begin(), _halfSpaces.end(), [ & ]( const HalfSpace & _halfSpace ) { return _halfSpace.Beyond( _shape ); } );
+        } };
+    std::array< unsigned, 64 > stack;
+    unsigned stackSize{ 0 };
+    stack[ stackSize++ ] = 0;
+    while( stackSize != 0 ) {
+        const auto & node{ _tree.nodes[ stack[ --stackSize ] ] };
+        if( !BoundsOverlap( node.bounds, _bounds ) || Outside( node.bounds ) )
+            continue;
+        if( node.count == 0 ) {
+            stack[ stackSize++ ] = node.first;
+            stack[ stackSize++ ] = node.first + 1;
+            continue;
+        }
+        for( unsigned i{ node.first }; i < node.first + node.count; ++i ) {
+            const auto occluder{ _tree.plateIndices[ i ] };
+            if( BoundsOverlap( PlateBounds( _quads[ occluder ] ), _bounds ) && !Outside( _quads[ occluder ] ) && _Predicate( occluder ) )
+                _occluders.emplace_back( occluder );
+        }
+    }
+}
+
+// whether every segment between two quads crosses the occluder: the quads lie on either side of its plane and the crossings of
+// the segments between their corners, whose convex hull holds every other crossing, lie inside it, away from its edges:
+inline static bool QuadBlocks( const Quad & _occluder, const Quad & _a, const Quad & _b, const Real _margin )
+{
+    const auto normal{ VecNorm( VecCross( VecSub( _occluder[ 1 ], _occluder[ 0 ] ), VecSub( _occluder[ 3 ], _occluder[ 0 ] ) ) ) };
+    std::array< Real, 4 > heightsA;
+    std::array< Real, 4 > heightsB;
+    for( int i{ 0 }; i < 4; ++i ) {
+        heightsA[ i ] = VecDot( VecSub( _a[ i ], _occluder[ 0 ] ), normal );
+        heightsB[ i ] = VecDot( VecSub( _b[ i ], _occluder[ 0 ] ), normal );
+    }
+    const auto side{ heightsA[ 0 ] > 0 ? Real{ 1 } : Real{ -1 } };
+    for( int i{ 0 }; i < 4; ++i )
+        if( heightsA[ i ] * side <= _margin || heightsB[ i ] * side >= -_margin )
+            return false;
+    for( int i{ 0 }; i < 4; ++i ) {
+        for( int j{ 0 }; j < 4; ++j ) {
+            const auto crossing{ VecAdd( _a[ i ], VecMult( VecSub( _b[ j ], _a[ i ] ), heightsA[ i ] / ( heightsA[ i ] - heightsB[ j ] ) ) ) };
+            for( int k{ 0 }; k < 4; ++k ) {
+                const auto edge{ VecSub( _occluder[ ( k + 1 ) % 4 ], _occluder[ k ] ) };
+                if( VecDot( VecCross( edge, VecSub( crossing, _occluder[ k ] ) ), normal ) <= _margin * VecDist( { 0, 0, 0 }, edge ) )
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// heights of the corners of a quad over a plane, lowest then highest:
+inline static std::pair< Real, Real > QuadHeights( const Quad & _quad, const Vector3D & _origin, const Vector3D & _normal )
+{
+    std::pair< Real, Real > heights{ std::numeric_limits< Real >::max(), std::numeric_limits< Real >::lowest() };
+    for( const auto & position : _quad ) {
+        const auto height{ VecDot( VecSub( position, _origin ), _normal ) };
+        heights = { std::min( heights.first, height ), std::max( heights.second, height ) };
+    }
+    return heights;
+}
+
+// planes bounding the convex hull of two quads: through an edge of one quad and a corner of the other one, when every corner
+// lies on one side, the outside of the hull being beyond them:
+inline static void AddHullPlanes( const Quad & _a, const Quad & _b, const Real _margin, std::vector< HalfSpace > & _halfSpaces )
+{
+    const auto firstHalfSpace{ _halfSpaces.size() };
+    const auto AddPlanes{ [ & ]( const Quad & _edges, const Quad & _corners ) {
+            for( int i{ 0 }; i < 4; ++i ) {
+                for( const auto & corner : _corners ) {
+                    const auto cross{ VecCross( VecSub( _edges[ ( i + 1 ) % 4 ], _edges[ i ] ), VecSub( corner, _edges[ i ] ) ) };
+                    const auto length{ VecDist( { 0, 0, 0 }, cross ) };
+                    if( !( length > 0 ) )
+                        continue;
+                    const auto normal{ VecMult( cross, Real{ 1 } / length ) };
+                    const auto offset{ VecDot( normal, _edges[ i ] ) };
+                    Real minHeight{ 0 };
+                    Real maxHeight{ 0 };
+                    for( const auto * pQuad : { &_a, &_b } ) {
+                        for( const auto & position : *pQuad ) {
+                            minHeight = std::min( minHeight, VecDot( normal, position ) - offset );
+                            maxHeight = std::max( maxHeight, VecDot( normal, position ) - offset );
+                        }
+                    }
+                    HalfSpace halfSpace;
+                    if( maxHeight <= 0 )
+                        halfSpace = { normal, offset, _margin };
+                    else
+                    if( minHeight >= 0 )
+                        halfSpace = { VecMult( normal, Real{ -1 } ), -offset, _margin };
+                    else
+                        continue;
+                    if( std::none_of( _halfSpaces.begin() + static_cast< std::ptrdiff_t >( firstHalfSpace ), _halfSpaces.end(), [ & ]( const HalfSpace & _other ) {
+                            return _other.normal == halfSpace.normal && _other.offset == halfSpace.offset;
+                        } ) )
+                        _halfSpaces.emplace_back( halfSpace );
+                }
+            }
+        } };
+    AddPlanes( _a, _b );
+    AddPlanes( _b, _a );
+}
+
+template< typename T >
+PlateVisibilitySet BuildPlateVisibility( const Plates & _plates, const Occlusion & _occlusion, const PlateRange & _receivers, TaskPool & _pool )
+{
+    // the facing test rounds the positions to the engine precision, the occlusion test runs in geometry precision:
+    Real extent{ 1 };
+    for( const auto & plate : _plates )
+        for( const auto & position : plate.positions )
+            for( const auto coordinate : position )
+                extent = std::max( extent, std::abs( coordinate ) );
+    const auto facingMargin{ 64 * static_cast< Real >( std::numeric_limits< T >::epsilon() ) * extent };
+    const auto occlusionMargin{ 0.000001 * extent };
+    const auto OccluderOf{ [ & ]( const std::size_t _plateIndex ) {
+            return _occlusion.pPlateOccluders != nullptr ? ( *_occlusion.pPlateOccluders )[ _plateIndex ] : _plateIndex;
+        } };
+
+    // photons sit on the plates, shifted along their normal:
+    Quads photonQuads;
+    for( const auto & plate : _plates ) {
+        auto & quad{ photonQuads.emplace_back( plate.positions ) };
+        for( auto & position : quad )
+            position = EmitterPhotonPosition( position, plate.normal );
+    }
+    const auto plateCount{ _plates.size() };
+    PlateVisibilitySet visibility{ std::vector< PlateVisibilitySet::Row >( plateCount ) };
+    _pool.Run( _receivers.size(), [ & ]( const std::size_t _task ) {
+        const auto plateIndex{ _receivers.first + _task };
+        const auto & plate{ _plates[ plateIndex ] };
+        const auto plateBounds{ PlateBounds( plate.positions ) };
+        const auto skippedOccluder{ OccluderOf( plateIndex ) };
+        auto & row{ visibility.rows[ plateIndex ] };
+        std::vector< HalfSpace > halfSpaces;
+        row.pairs.resize( plateCount );
+        row.firstOccluders.resize( plateCount + 1 );
+        for( std::size_t sourcePlate{ 0 }; sourcePlate < plateCount; ++sourcePlate ) {
+            auto & pair{ row.pairs[ sourcePlate ] };
+            row.firstOccluders[ sourcePlate ] = static_cast< std::uint32_t >( row.occluders.size() );
+            const auto & photonQuad{ photonQuads[ sourcePlate ] };
+            const auto & normal{ _plates[ sourcePlate ].normal };
+            const auto heights{ QuadHeights( plate.positions, photonQuad[ 0 ], normal ) };
+            if( heights.second < -facingMargin ) {
+                pair = PlateVisibility::culled;
+                continue;
+            }
+
+            // the rays the facing test lets through run above the photon plane less the facing margin, on the side of the receiving
+            // plate where the photons are when they all are on one side, and within the hull of the two plates, the source occluder
+            // being behind them when the plate is in front:
+            const auto sourceOccluder{ heights.first > -photonShift / 2 ? OccluderOf( sourcePlate ) : skippedOccluder };
+            halfSpaces.assign( 1, { VecMult( normal, Real{ -1 } ), -VecDot( normal, photonQuad[ 0 ] ), facingMargin + occlusionMargin } );
+            const auto photonHeights{ QuadHeights( photonQuad, plate.positions[ 0 ], plate.normal ) };
+            if( photonHeights.first > occlusionMargin )
+                halfSpaces.push_back( { VecMult( plate.normal, Real{ -1 } ), -VecDot( plate.normal, plate.positions[ 0 ] ), occlusionMargin } );
+            else
+            if( photonHeights.second < -occlusionMargin )
+                halfSpaces.push_back( { plate.normal, VecDot( plate.normal, plate.positions[ 0 ] ), occlusionMargin } );
+            AddHullPlanes( plate.positions, photonQuad, occlusionMargin, halfSpaces );
+            const auto firstOccluder{ row.occluders.size() };
+            CollectOccluders( _occlusion.tree, _occlusion.quads, BoundsUnion( plateBounds, PlateBounds( photonQuad ) ), halfSpaces, [ & ]( const unsigned _occluder ) {
+                    if( _occluder == skippedOccluder || _occluder == sourceOccluder )
+                        return false;
+
+                    // the hull of the two plates is on one side of the occluder:
+                    const auto & quad{ _occlusion.quads[ _occluder ] };
+                    const auto occluderNormal{ VecNorm( VecCross( VecSub( quad[ 1 ], quad[ 0 ] ), VecSub( quad[ 3 ], quad[ 0 ] ) ) ) };
+                    const auto plateHeights{ QuadHeights( plate.positions, quad[ 0 ], occluderNormal ) };
+                    const auto sourceHeights{ QuadHeights( photonQuad, quad[ 0 ], occluderNormal ) };
+                    return std::min( plateHeights.first, sourceHeights.first ) <= occlusionMargin && std::max( plateHeights.second, sourceHeights.second ) >= -occlusionMargin;
+                }, row.occluders );
+            if( row.occluders.size() == firstOccluder ) {
+                pair = PlateVisibility::unoccluded;
+                continue;
+            }
+
+            // an occluder crossed by every segment is crossed by the one between the centers, and most blocked rays stop
+            // at the occluders crossing it, tested first:
+            const auto itFirst{ row.occluders.begin() + static_cast< std::ptrdiff_t >( firstOccluder ) };
+            const auto center{ VecMult( VecAdd( plate.positions[ 0 ], plate.positions[ 2 ] ), Real{ 0.5 } ) };
+            const auto sourceCenter{ VecMult( VecAdd( photonQuad[ 0 ], photonQuad[ 2 ] ), Real{ 0.5 } ) };
+            const auto itCrossing{ std::stable_partition( itFirst, row.occluders.end(), [ & ]( const unsigned _occluder ) {
+                    return SegmentIntersectsPlate( center, sourceCenter, _occlusion.quads[ _occluder ] );
+                } ) };
+            if( std::any_of( itFirst, itCrossing, [ & ]( const unsigned _occluder ) { return QuadBlocks( _occlusion.quads[ _occluder ], plate.positions, photonQuad, occlusionMargin ); } ) ) {
+                pair = PlateVisibility::culled;
+                row.occluders.resize( firstOccluder );
+                continue;
+            }
+            pair = PlateVisibility::partial;
+            if( row.occluders.size() - firstOccluder > maxPairOccluders )
+                row.occluders.resize( firstOccluder ); // tested against the tree
+        }
+        row.firstOccluders.back() = static_cast< std::uint32_t >( row.occluders.size() );
+    } );
+    return visibility;
+}
+
+
+// texel-to-texel transport terms: from the second pass on, every photon sits on an emitter texel, so visibility
+// and geometric terms between two texels are the same for every pass and can be computed once:
+template< typename T >
+struct VisibilityCache
+{
+    struct Entry
+    {
+        unsigned source; // emitter texel, in the atlas
+        unsigned texel; // receiver texel index in the plate
+        T distanceFactor;
+        T raySrcAngle;
+    };
+    std::vector< std::vector< Entry > > plates; // per receiving plate, sorted by source then texel
+    std::size_t entryCount;
+};
+
+// visible texel pairs of a (receiving plate, source plate) pair, in source then texel order, the pairs the plate visibility culls
+// being skipped and the rays of the unoccluded ones not being tested:
+template< typename T, unsigned TextureWidth >
+void TracePlatePair( const Transport< T > & _transport, const std::vector< Texels< T > > & _texels, const std::size_t _plateIndex, const std::size_t _sourcePlate,
+    const PlateVisibilitySet * _pPlateVisibility, std::vector< typename VisibilityCache< T >::Entry > & _entries )
+{
+    using Entry = typename VisibilityCache< T >::Entry;
+    const auto pairVisibility{ _pPlateVisibility != nullptr ? ( *_pPlateVisibility )( _plateIndex, _sourcePlate ) : PlateVisibility::partial };
+    if( pairVisibility == PlateVisibility::culled )
+        return;
+    auto occlusion{ *_transport.pOcclusion };
+    if( _pPlateVisibility != nullptr && !_pPlateVisibility->Occluders( _plateIndex, _sourcePlate ).empty() )
+        occlusion.candidates = _pPlateVisibility->Occluders( _plateIndex, _sourcePlate );
+    const auto & plateTexels{ _texels[ _plateIndex ] };
+    const auto & sourceTexels{ _texels[ _sourcePlate ] };
+    const auto & plate2{ _transport.plates[ _sourcePlate ] };
+    const auto normal{ VecCast< T >( plate2.normal ) };
+    std::uint64_t facingRejections{ 0 };
+    for( unsigned source{ 0 }; source < sourceTexels.positions.x.size(); ++source ) {
+        const auto photonPosition{ EmitterPhotonPosition( GeometryTexelPosition< T, TextureWidth >( _transport, sourceTexels, _sourcePlate, source ), plate2.normal ) };
+        const auto enginePhotonPosition{ VecCast< T >( photonPosition ) };
+        for( unsigned texel{ 0 }; texel < plateTexels.positions.x.size(); ++texel ) {
+            const auto position{ VecArrayGet( plateTexels.positions, texel ) };
+            const auto rayNormal{ VecNorm( VecSub( enginePhotonPosition, position ) ) };
+            if( !VecFacing( rayNormal, normal ) ) {
+                ++facingRejections;
+                continue;
+            }
+            if( pairVisibility == PlateVisibility::partial && occlusion( GeometryTexelPosition< T, TextureWidth >( _transport, plateTexels, _plateIndex, texel ), photonPosition, _plateIndex ) )
+                continue;
+            _entries.emplace_back( Entry{ static_cast< unsigned >( sourceTexels.offset + source ), texel,
+                DistanceFactor( _transport.wavelengthDecayDistance, VecDist( enginePhotonPosition, position ) ), -VecDot( normal, rayNormal ) } );
+        }
+    }
+    if( pThreadCounters != nullptr )
+        pThreadCounters->facingRejections += facingRejections;
+}
+
+// appends the entries of every (receiving plate, source plate) pair in source order, releasing them:
+template< typename T >
+VisibilityCache< T > GatherVisibilityCache( std::vector< std::vector< typename VisibilityCache< T >::Entry > > & _pairEntries, const std::size_t _plateCount,
+    const PlateRange & _receivers, TaskPool & _pool )
+{
+    using Entry = typename VisibilityCache< T >::Entry;
+    VisibilityCache< T > cache{ std::vector< std::vector< Entry > >( _plateCount ), 0 };
+    _pool.Run( _receivers.size(), [ & ]( const std::size_t _task ) {
+        auto & entries{ cache.plates[ _receivers.first + _task ] };
+        std::size_t plateEntryCount{ 0 };
+        for( std::size_t sourcePlate{ 0 }; sourcePlate < _plateCount; ++sourcePlate )
+            plateEntryCount += _pairEntries[ _task * _plateCount + sourcePlate ].size();
+        entries.reserve( plateEntryCount );
+        for( std::size_t sourcePlate{ 0 }; sourcePlate < _plateCount; ++sourcePlate ) {
+            auto & sourceEntries{ _pairEntries[ _task * _plateCount + sourcePlate ] };
+            entries.insert( entries.end(), sourceEntries.begin(), sourceEntries.end() );
+            std::vector< Entry >{}.swap( sourceEntries );
+        }
+    } );
+    for( const auto & entries : cache.plates )
+        cache.entryCount += entries.size();
+    return cache;
+}
+
+// returns an empty cache as soon as the entries would not fit in the memory budget,
+// every (receiving plate, source plate) pair is a task whose entries are appended in source order afterwards:
+template< typename T, unsigned TextureWidth >
+std::optional< VisibilityCache< T > > BuildVisibilityCache( const Transport< T > & _transport, const std::vector< Texels< T > > & _texels, const std::size_t _budget,
+    const PlateVisibilitySet * _pPlateVisibility, const PlateRange & _receivers, TaskPool & _pool )
+{
+    using Entry = typename VisibilityCache< T >::Entry;
+    const auto & plates{ _transport.plates };
+    std::atomic< std::size_t > entryCount{ 0 };
+    const auto maxEntryCount{ _budget / sizeof( Entry ) };
+    std::vector< std::vector< Entry > > pairEntries( _receivers.size() * plates.size() );
+    _pool.Run( pairEntries.size(), [ & ]( const std::size_t _task ) {
+        if( entryCount.load( std::memory_order_relaxed ) > maxEntryCount )
+            return;
+        auto & entries{ pairEntries[ _task ] };
+        TracePlatePair< T, TextureWidth >( _transport, _texels, _receivers.first + _task / plates.size(), _task % plates.size(), _pPlateVisibility, entries );
+        entryCount += entries.size();
+    } );
+    if( entryCount > maxEntryCount )
+        return std::nullopt;
+    return GatherVisibilityCache< T >( pairEntries, plates.size(), _receivers, _pool );
+}
+
+
+// emitter energies of a plate summed level by level, level 0 being the texels and each level halving the resolution:
+template< typename T >
+struct EmitterPyramid
+{
+    std::vector< std::vector< Vector3D > > positions; // cluster centers, fixed
+    std::vector< std::vector< Vector3< T > > > colors; // cluster energies, updated every pass
+};
+
+inline static unsigned PyramidLevelCount( const unsigned _textureWidth )
+{
+    unsigned levelCount{ 1 };
+    while( ( _textureWidth >> ( levelCount - 1 ) ) > 1 )
+        ++levelCount;
+    return levelCount;
+}
+
+template< typename T >
+EmitterPyramid< T > BuildEmitterPyramid( const Plate & _plate, const unsigned _textureWidth )
+{
+    const auto levelCount{ PyramidLevelCount( _textureWidth ) };
+    EmitterPyramid< T > pyramid{ std::vector< std::vector< Vector3D > >( levelCount ), std::vector< std::vector< Vector3< T > > >( levelCount ) };
+    for( unsigned y{ 0 }; y < _textureWidth; ++y )
+        for( unsigned x{ 0 }; x < _textureWidth; ++x )
+            pyramid.positions[ 0 ].emplace_back( TexelPosition( _plate, x, y, _textureWidth ) );
+    for( unsigned level{ 1 }; level < levelCount; ++level ) {
+        const auto width{ _textureWidth >> level };
+        const auto & children{ pyramid.positions[ level - 1 ] };
+        for( unsigned y{ 0 }; y < width; ++y ) {
+            for( unsigned x{ 0 }; x < width; ++x ) {
+                const auto child{ 2 * y * 2 * width + 2 * x };
+                const auto sum{ VecAdd( VecAdd( children[ child ], children[ child + 1 ] ), VecAdd( children[ child + 2 * width ], children[ child + 2 * width + 1 ] ) ) };
+                pyramid.positions[ level ].emplace_back( VecMult( sum, Real{ 0.25 } ) );
+            }
+        }
+    }
+    for( unsigned level{ 0 }; level < levelCount; ++level )
+        pyramid.colors[ level ].resize( pyramid.positions[ level ].size() );
+    return pyramid;
+}
+
+// sums the photon energies of the plate (zero on texels which are not photons) up the pyramid:
+template< typename T, typename TexelColor >
+void UpdateEmitterPyramid( EmitterPyramid< T > & _pyramid, const unsigned _textureWidth, const TexelColor & _TexelColor )
+{
+    auto & texels{ _pyramid.colors[ 0 ] };
+    for( unsigned texel{ 0 }; texel < texels.size(); ++texel )
+        texels[ texel ] = _TexelColor( texel );
+    for( unsigned level{ 1 }; level < _pyramid.colors.size(); ++level ) {
+        const auto width{ _textureWidth >> level };
+        const auto & children{ _pyramid.colors[ level - 1 ] };
+        auto itColor{ _pyramid.colors[ level ].begin() };
+        for( unsigned y{ 0 }; y < width; ++y ) {
+            for( unsigned x{ 0 }; x < width; ++x, ++itColor ) {
+                const auto child{ 2 * y * 2 * width + 2 * x };
+                *itColor = VecAdd( VecAdd( children[ child ], children[ child + 1 ] ), VecAdd( children[ child + 2 * width ], children[ child + 2 * width + 1 ] ) );
+            }
+        }
+    }
+}
+
+template< typename T >
+inline static Real Energy( const Vector3< T > & _color )
+{
+    return static_cast< Real >( _color[ 0 ] + _color[ 1 ] + _color[ 2 ] );
+}
+
+struct Cluster
+{
+    unsigned plate;
+    unsigned level;
+    unsigned index;
+    auto operator <=>( const Cluster & ) const = default;
+};
+
+// hierarchical radiosity like refinement: a cluster is shot as a single photon unless it is close to the receiving plate
+// relatively to its width, weighted by its share of the brightest plate energy, in which case its four children are tested:
+template< typename T >
+void SelectClusters( const EmitterPyramid< T > & _pyramid, const unsigned _plate, const unsigned _textureWidth, const Real _plateWidth,
+    const Vector3D & _receiverCenter, const Real _receiverRadius, const Real _maxEnergy, const Real _threshold, std::vector< Cluster > & _clusters )
+{
+    const auto Refine{ [ & ]( const auto & _Refine, const unsigned _level, const unsigned _x, const unsigned _y ) -> void {
+            const auto width{ _textureWidth >> _level };
+            const auto index{ _y * width + _x };
+            const auto energy{ Energy( _pyramid.colors[ _level ][ index ] ) };
+            if( !( energy > 0 ) )
+                return; // no photon in this cluster
+            if( _level != 0 ) {
+                const auto clusterWidth{ _plateWidth * static_cast< Real >( 1u << _level ) / static_cast< Real >( _textureWidth ) };
+                const auto distance{ VecDist( _pyramid.positions[ _level ][ index ], _receiverCenter ) - _receiverRadius };
+                if( distance <= 0 || clusterWidth / distance * energy / _maxEnergy > _threshold ) {
+                    for( unsigned child{ 0 }; child < 4; ++child )
+                        _Refine( _Refine, _level - 1, 2 * _x + ( child & 1 ), 2 * _y + ( child >> 1 ) );
+                    return;
+                }
+            }
+            _clusters.emplace_back( Cluster{ _plate, _level, index } );
+        } };
+    Refine( Refine, static_cast< unsigned >( _pyramid.colors.size() - 1 ), 0, 0 );
+}
+
+
+// photon energies are scaled up during the transport and scaled back down once it is over,
+// a power of ten only shifts the exponent so it does not add precision, it keeps the summed values away from denormals:
+inline static constexpr Real realMultiplier{ 1000 };
+
+// stochastic transport rays: at uniform texels of uniform plates, or along cosine-weighted directions up to the nearest plate:
+enum class RaySampling { plates, cosine };
+
+// lightmap texture of the whole scene: the plate tiles laid out row after row on a square grid, every tile being framed by a border
+// replicating its edge texels, so that linear filtering never blends two neighbour tiles:
+inline static constexpr unsigned atlasBorder{ 1 };
+
+// texture coordinates of the plate corners in the plate tile:
+inline static constexpr std::array< Vector2D, 4 > plateTextures{ Vector2D{ 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+
+struct TextureAtlas
+{
+    unsigned tileWidth; // plate texels, border excluded
+    unsigned columns;
+    unsigned width; // in texels
+    unsigned height;
+
+    // texel ( 0, 0 ) of a plate in the atlas:
+    std::array< unsigned, 2 > TileOrigin( const std::size_t _plate ) const
+    {
+        const auto stride{ tileWidth + 2 * atlasBorder };
+        return { static_cast< unsigned >( _plate % columns ) * stride + atlasBorder, static_cast< unsigned >( _plate / columns ) * stride + atlasBorder };
+    }
+};
+
+inline static TextureAtlas MakeTextureAtlas( const std::size_t _plateCount, const unsigned _tileWidth )
+{
+    const auto stride{ _tileWidth + 2 * atlasBorder };
+    const auto columns{ std::max( 1u, static_cast< unsigned >( std::ceil( std::sqrt( static_cast< double >( _plateCount ) ) ) ) ) };
+    const auto rows{ std::max( 1u, static_cast< unsigned >( ( _plateCount + columns - 1 ) / columns ) ) };
+    return { _tileWidth, columns, columns * stride, rows * stride };
+}
+
+// received energy of a plate of the given texture width bilinearly interpolated between its texel centres, the coordinates
+// being in texels and clamped to the plate edges:
+template< typename Receiver >
+inline static Vector3D SampleTexels( const unsigned _width, const Receiver & _Receiver, const Real _x, const Real _y )
+{
+    const auto last{ static_cast< Real >( _width - 1 ) };
+    const auto x{ std::clamp< Real >( _x, 0, last ) };
+    const auto y{ std::clamp< Real >( _y, 0, last ) };
+    const auto x0{ std::min( static_cast< unsigned >( x ), _width - 1 ) };
+    const auto y0{ std::min( static_cast< unsigned >( y ), _width - 1 ) };
+    const auto x1{ std::min( x0 + 1, _width - 1 ) };
+    const auto y1{ std::min( y0 + 1, _width - 1 ) };
+    const auto fx{ x - static_cast< Real >( x0 ) };
+    const auto fy{ y - static_cast< Real >( y0 ) };
+    const auto Texel{ [ & ]( const unsigned _tx, const unsigned _ty ) { return VecCast< Real >( _Receiver( std::size_t{ _ty } * _width + _tx ) ); } };
+    const auto Lerp{ [ & ]( const Vector3D & _a, const Vector3D & _b, const Real _f ) { return VecAdd( VecMult( _a, 1 - _f ), VecMult( _b, _f ) ); } };
+    return Lerp( Lerp( Texel( x0, y0 ), Texel( x1, y0 ), fx ), Lerp( Texel( x0, y1 ), Texel( x1, y1 ), fx ), fy );
+}
+
+// received energies of a plate clamped to 8-bit colors, into its tile and the border around it, rows being the given count of colors
+// apart, a plate of another texture width than the tile being resampled:
+template< typename Receiver >
+inline static void TileColors( const unsigned _tileWidth, const unsigned _receiverWidth, const Receiver & _Receiver, Color * const _pColors,
+    const std::size_t _rowStride )
+{
+    const auto width{ static_cast< int >( _tileWidth ) };
+    const auto border{ static_cast< int >( atlasBorder ) };
+    const auto scale{ static_cast< Real >( _receiverWidth ) / _tileWidth };
+    for( int y{ -border }; y < width + border; ++y ) {
+        auto pColor{ _pColors + static_cast< std::size_t >( y + border ) * _rowStride };
+        for( int x{ -border }; x < width + border; ++x ) {
+            const auto tileX{ std::clamp( x, 0, width - 1 ) };
+            const auto tileY{ std::clamp( y, 0, width - 1 ) };
+            const Vector3D receiver{ _receiverWidth == _tileWidth ? Vector3D{ _Receiver( static_cast< std::size_t >( tileY * width + tileX ) ) }
+                : SampleTexels( _receiverWidth, _Receiver, ( tileX + Real( 0.5 ) ) * scale - Real( 0.5 ), ( tileY + Real( 0.5 ) ) * scale - Real( 0.5 ) ) };
+            const auto colorR{ static_cast< unsigned char >( std::clamp< Real >( receiver[ 0 ], 0, 1 ) * 255 ) };
+            const auto colorG{ static_cast< unsigned char >( std::clamp< Real >( receiver[ 1 ], 0, 1 ) * 255 ) };
+            const auto colorB{ static_cast< unsigned char >( std::clamp< Real >( receiver[ 2 ], 0, 1 ) * 255 ) };
+            *pColor++ = { colorR, colorG, colorB };
+        }
+    }
+}
+
+// received energies clamped to 8-bit colors, tile by tile:
+std::vector< Color > AtlasColors( const TextureAtlas & _atlas, const Lightmaps & _lightmaps )
+{
+    std::vector< Color > colors( std::size_t{ _atlas.width } * _atlas.height, Color{ 0, 0, 0 } );
+    std::vector< std::size_t > plateIndices( _lightmaps.size() );
+    std::iota( plateIndices.begin(), plateIndices.end(), 0 );
+    std::for_each( std::execution::par_unseq, plateIndices.begin(), plateIndices.end(), [ & ]( const std::size_t _plateIndex ) {
+        const auto lightmap{ _lightmaps[ _plateIndex ] };
+        const auto [ originX, originY ]{ _atlas.TileOrigin( _plateIndex ) };
+        TileColors( _atlas.tileWidth, PlateWidth( _lightmaps.offsets, _plateIndex ), [ & ]( const std::size_t _texel ) { return VecArrayGet( lightmap, _texel ); },
+            colors.data() + ( originY - atlasBorder ) * std::size_t{ _atlas.width } + originX - atlasBorder, _atlas.width );
+    } );
+    return colors;
+}
+
+// atlas tiles published while the transport runs, for the viewer to show every plate as soon as a pass completes it: each tile has
+// three slots, the transport converting the plate into its own slot then exchanging it with the shared one, flagged as fresh,
+// and the viewer exchanging the shared slot with its own when it is fresh, so that neither side ever waits for the other:
+struct LightmapPreview
+{
+    static constexpr std::uint8_t freshSlot{ 4 };
+
+    TextureAtlas atlas;
+    std::size_t tileSize; // colors of a tile, border included
+    std::vector< Color > slots; // per plate, three tiles
+    std::vector< std::uint8_t > writerSlots; // the transport ones, a single task completing a plate at a time
+    std::vector< std::uint8_t > readerSlots; // the viewer ones
+    std::vector< std::atomic< std::uint8_t > > sharedSlots;
+    std::atomic< std::uint64_t > publishedCount{ 0 }; // tiles so far, the viewer looking for fresh ones when it changes only
+    std::atomic< bool > complete{ false }; // once the final lightmaps are published
+    std::uint64_t uploadedCount{ 0 };
+    std::uint64_t seenCount{ 0 };
+    const std::chrono::high_resolution_clock::time_point start{ std::chrono::high_resolution_clock::now() };
+    std::optional< std::chrono::high_resolution_clock::time_point > firstImage;
+
+    LightmapPreview( const std::size_t _plateCount, const unsigned _tileWidth )
+        : atlas{ MakeTextureAtlas( _plateCount, _tileWidth ) }, tileSize{ std::size_t{ _tileWidth + 2 * atlasBorder } * ( _tileWidth + 2 * atlasBorder ) },
+          slots( _plateCount * 3 * tileSize ), writerSlots( _plateCount, 0 ), readerSlots( _plateCount, 1 ), sharedSlots( _plateCount )
+    {
+        for( auto & shared : sharedSlots )
+            shared.store( 2, std::memory_order_relaxed );
+    }
+
+    // the plate received energies, scaled back, converted into a fresh tile:
+    template< typename Receiver >
+    void Publish( const std::size_t _plate, const unsigned _width, const Receiver & _Receiver )
+    {
+        TileColors( atlas.tileWidth, _width, _Receiver, slots.data() + ( _plate * 3 + writerSlots[ _plate ] ) * tileSize, atlas.tileWidth + 2 * atlasBorder );
+        writerSlots[ _plate ] = sharedSlots[ _plate ].exchange( static_cast< std::uint8_t >( writerSlots[ _plate ] | freshSlot ), std::memory_order_acq_rel ) & 3;
+        publishedCount.fetch_add( 1, std::memory_order_release );
+    }
+
+    void Publish( const Lightmaps & _lightmaps )
+    {
+        for( std::size_t plateIndex{ 0 }; plateIndex < _lightmaps.size(); ++plateIndex ) {
+            const auto lightmap{ _lightmaps[ plateIndex ] };
+            Publish( plateIndex, PlateWidth( _lightmaps.offsets, plateIndex ), [ & ]( const std::size_t _texel ) { return VecArrayGet( lightmap, _texel ); } );
+        }
+    }
+
+    bool Fresh() const
+    {
+        return publishedCount.load( std::memory_order_acquire ) != seenCount;
+    }
+
+    // the fresh tiles, into the bound atlas texture of the viewer:
+    void Upload()
+    {
+        const auto publishedSoFar{ publishedCount.load( std::memory_order_acquire ) };
+        if( publishedSoFar == seenCount )
+            return;
+        seenCount = publishedSoFar;
+        const auto stride{ static_cast< GLsizei >( atlas.tileWidth + 2 * atlasBorder ) };
+        for( std::size_t plateIndex{ 0 }; plateIndex < sharedSlots.size(); ++plateIndex ) {
+            if( ( sharedSlots[ plateIndex ].load( std::memory_order_relaxed ) & freshSlot ) == 0 )
+                continue;
+            readerSlots[ plateIndex ] = sharedSlots[ plateIndex ].exchange( readerSlots[ plateIndex ], std::memory_order_acq_rel ) & 3;
+            const auto [ originX, originY ]{ atlas.TileOrigin( plateIndex ) };
+            ::glTexSubImage2D( GL_TEXTURE_2D, 0, static_cast< GLint >( originX - atlasBorder ), static_cast< GLint >( originY - atlasBorder ), stride, stride, GL_RGB, GL_UNSIGNED_BYTE,
+                slots.data() + ( plateIndex * 3 + readerSlots[ plateIndex ] ) * tileSize );
+            ++uploadedCount;
+        }
+    }
+
+    // the first frame showing published tiles is the first image, timed from the start of the computation:
+    void FrameDrawn( Trace * _pTrace )
+    {
+        if( firstImage || uploadedCount == 0 )
+            return;
+        firstImage = std::chrono::high_resolution_clock::now();
+        if( _pTrace != nullptr )
+            _pTrace->Add( { "first image", start, *firstImage, { { "tiles", static_cast< double >( uploadedCount ) } } } );
+        std::cout << "time to first image: " << std::chrono::duration< double, std::milli >( *firstImage - start ).count() << "ms, "
+                  << uploadedCount << " tile(s) shown" << std::endl;
+    }
+};
+
+// sharded solve: worker processes of this executable each run every pass on their own range of receiving plates, then exchange
+// the photons their plates emit through a shared file mapping, the coordinator process merging them in plate order into the photon
+// list of the next pass; the lightmaps of every shard are written back to the mapping once the passes are over:
+inline static constexpr std::array< char, 8 > shardMagic{ 'L', 'S', 'H', 'O', 'T', 'S', 'H', 'D' };
+inline static constexpr std::uint32_t shardVersion{ 1 };
+
+struct ShardHeader
+{
+    std::array< char, 8 > magic;
+    std::uint32_t version;
+    std::uint32_t realSize; // engine precision
+    std::uint32_t shardCount;
+    std::uint32_t plateCount;
+    std::uint32_t lightSourceCount;
+    std::uint32_t maxRenderingPass;
+    std::uint64_t texelCount; // of every plate
+    Scene scene;
+    std::uint64_t controlOffset; // ShardControl
+    std::uint64_t slotsOffset; // ShardSlot[ shard ]
+    std::uint64_t platesOffset; // Plate[ plate ]
+    std::uint64_t lightSourcesOffset; // Photon< Real >[ light source ]
+    std::uint64_t photonsOffset; // Photon< T >[ texel ], merged photons of the last pass
+    std::uint64_t photonIndicesOffset; // unsigned[ texel ], merged
+    std::uint64_t shardPhotonsOffset; // Photon< T >[ texel ], the photons of a shard from its first texel on
+    std::uint64_t shardPhotonIndicesOffset; // unsigned[ texel ], the photon indices of the shard texels within the shard photons
+    std::uint64_t receiversOffset; // Real[ 3 ][ texel ], lightmaps component after component
+    std::uint64_t fileSize;
+};
+
+// written by the coordinator:
+struct ShardControl
+{
+    std::atomic< std::uint32_t > mergedPass; // the merged photons of which are in the mapping
+    std::atomic< std::uint32_t > aborted; // a process failed, the others leave
+    std::uint64_t photonCount; // merged
+    std::uint64_t coordinator; // process identifier, the workers leaving once it is gone
+};
+
+// written by its worker:
+struct ShardSlot
+{
+    std::uint64_t firstPlate;
+    std::uint64_t lastPlate;
+    std::uint64_t firstTexel;
+    std::uint64_t lastTexel;
+    std::uint64_t photonCount; // emitted by the shard plates during the pass done
+    std::uint64_t maxPlatePhotons; // clusters shot at a shard plate at most during the pass counted
+    std::atomic< std::uint32_t > donePass; // the photons and the photon indices of which are written
+    std::atomic< std::uint32_t > countedPass;
+    std::atomic< std::uint32_t > finished; // once the lightmaps are written
+};
+
+static_assert( std::atomic< std::uint32_t >::is_always_lock_free, "the exchange words are shared between processes" );
+
+// the mapping as a worker process sees it:
+struct ShardWorker
+{
+    const ShardHeader * pHeader;
+    ShardControl * pControl;
+    ShardSlot * pSlots;
+    unsigned index;
+#if defined( _WIN32 )
+    // the coordinator process, opened once to tell when it is gone, none when it is gone already:
+    HANDLE coordinatorProcess{ ::OpenProcess( SYNCHRONIZE, FALSE, static_cast< DWORD >( pControl->coordinator ) ) };
+#endif
+
+    template< typename V >
+    V * Section( const std::uint64_t _offset ) const
+    {
+        return reinterpret_cast< V * >( reinterpret_cast< std::byte * >( const_cast< ShardHeader * >( pHeader ) ) + _offset );
+    }
+
+    ShardSlot & Slot() const { return pSlots[ index ]; }
+    PlateRange Plates() const { return { static_cast< std::size_t >( Slot().firstPlate ), static_cast< std::size_t >( Slot().lastPlate ) }; }
+
+    // once the exchange is aborted or the coordinator is gone:
+    bool Abandoned() const
+    {
+        if( pControl->aborted.load( std::memory_order_acquire ) != 0 )
+            return true;
+#if defined( _WIN32 )
+        return coordinatorProcess == nullptr || ::WaitForSingleObject( coordinatorProcess, 0 ) != WAIT_TIMEOUT;
+#else
+        return static_cast< std::uint64_t >( ::getppid() ) != pControl->coordinator;
+#endif
+    }
+
+    // polls until done, false once abandoned:
+    template< typename Done >
+    bool WaitFor( const Done & _Done ) const
+    {
+        while( !_Done() ) {
+            if( Abandoned() )
+                return false;
+            std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+        }
+        return true;
+    }
+
+    // the photons the shard plates emitted during the pass for those of every plate, merged by the coordinator:
+    template< typename T >
+    bool Exchange( const unsigned _pass, std::vector< Photon< T > > & _photons, std::vector< unsigned > & _photonIndices ) const
+    {
+        auto & slot{ Slot() };
+        std::copy( _photons.begin(), _photons.end(), Section< Photon< T > >( pHeader->shardPhotonsOffset ) + slot.firstTexel );
+        std::copy( _photonIndices.begin() + static_cast< std::ptrdiff_t >( slot.firstTexel ), _photonIndices.begin() + static_cast< std::ptrdiff_t >( slot.lastTexel ),
+            Section< unsigned >( pHeader->shardPhotonIndicesOffset ) + slot.firstTexel );
+        slot.photonCount = _photons.size();
+        slot.donePass.store( _pass, std::memory_order_release );
+        if( !WaitFor( [ & ]{ return pControl->mergedPass.load( std::memory_order_acquire ) >= _pass; } ) )
+            return false;
+        const auto * const pPhotons{ Section< const Photon< T > >( pHeader->photonsOffset ) };
+        _photons.assign( pPhotons, pPhotons + pControl->photonCount );
+        const auto * const pPhotonIndices{ Section< const unsigned >( pHeader->photonIndicesOffset ) };
+        _photonIndices.assign( pPhotonIndices, pPhotonIndices + pHeader->texelCount );
+        return true;
+    }
+
+    // the photon chunk count depends on the clusters shot at every plate, the shards meeting on their maximum:
+    std::optional< std::size_t > MaxPlatePhotons( const unsigned _pass, const std::size_t _shardMaxPhotons ) const
+    {
+        Slot().maxPlatePhotons = _shardMaxPhotons;
+        Slot().countedPass.store( _pass, std::memory_order_release );
+        std::size_t maxPhotons{ 0 };
+        for( unsigned shard{ 0 }; shard < pHeader->shardCount; ++shard ) {
+            if( !WaitFor( [ & ]{ return pSlots[ shard ].countedPass.load( std::memory_order_acquire ) >= _pass; } ) )
+                return std::nullopt;
+            maxPhotons = std::max( maxPhotons, static_cast< std::size_t >( pSlots[ shard ].maxPlatePhotons ) );
+        }
+        return maxPhotons;
+    }
+
+    void Finish( const Lightmaps & _lightmaps ) const
+    {
+        auto & slot{ Slot() };
+        auto * const pReceivers{ Section< Real >( pHeader->receiversOffset ) };
+        const auto count{ static_cast< std::ptrdiff_t >( slot.lastTexel - slot.firstTexel ) };
+        const auto first{ static_cast< std::ptrdiff_t >( slot.firstTexel ) };
+        std::copy_n( _lightmaps.texels.x.begin() + first, count, pReceivers + slot.firstTexel );
+        std::copy_n( _lightmaps.texels.y.begin() + first, count, pReceivers + pHeader->texelCount + slot.firstTexel );
+        std::copy_n( _lightmaps.texels.z.begin() + first, count, pReceivers + 2 * pHeader->texelCount + slot.firstTexel );
+        slot.finished.store( 1, std::memory_order_release );
+    }
+};
+
+struct Options
+{
+    std::size_t cacheBudget{ 1024 }; // in megabytes
+    std::optional< Real > hierarchicalThreshold;
+    KernelIsa kernelIsa{ KernelIsa::scalar };
+    unsigned threadCount{ 1 };
+    bool plateTasks{ false }; // one task per plate instead of (plate, tile, photon chunk) tasks
+    bool plateCulling{ true }; // plate pairs which cannot exchange energy skipped before the texel loops
+    bool verbose{ true };
+    const char * pCheckpointPath{ nullptr }; // snapshot written after every pass, none when null
+    bool resume{ false }; // from the checkpoint
+    std::optional< unsigned > morePasses; // on top of the resumed ones, instead of the maximum pass count
+    const char * pRelightPath{ nullptr }; // incremental relighting state, read then written back, none when null
+    Trace * pTrace{ nullptr }; // scoped timers and pass counters, none when null
+    std::optional< Real > rouletteThreshold; // russian roulette on the emitters below this fraction of their mean energy
+    std::size_t photonBudget{ 0 }; // expected photon count per pass, russian roulette raising the threshold to meet it, none when 0
+    std::size_t monteCarloRays{ 0 }; // random rays per pass of the stochastic transport, exhaustive transport when 0
+    RaySampling raySampling{ RaySampling::plates };
+    unsigned monteCarloIterations{ 16 }; // accumulated progressively, every one running all of the passes
+    std::optional< double > monteCarloSeconds; // accumulation stopped past this duration, whatever the iteration count
+    LightmapPreview * pPreview{ nullptr }; // plate tiles published as the passes complete them, for the viewer, none when null
+    const ShardWorker * pShard{ nullptr }; // receiving plates and photon exchange of a worker process of the sharded solve, none when null
+    const std::vector< unsigned > * pPlateWidths{ nullptr }; // texture width of every plate, the scene one for every plate when null
+};
+
+// the photons shot at a plate are split in chunks so that a tile is shared among several tasks, the chunk count only depends on
+// the photon count, so the summation order, hence the lightmaps, do not depend on the thread count:
+inline static constexpr std::size_t minChunkPhotons{ 256 };
+inline static constexpr std::size_t maxPhotonChunks{ 8 };
+
+inline static std::size_t PhotonChunkCount( const std::size_t _photonCount )
+{
+    return std::clamp< std::size_t >( _photonCount / minChunkPhotons, 1, maxPhotonChunks );
+}
+
+// transport state after a pass, the emitters being converted to photons then: the receivers of every plate,
+// the photon list and the photon index of every texel, tied to the scene by a hash of everything the state depends on:
+inline static constexpr std::array< char, 8 > checkpointMagic{ 'L', 'S', 'H', 'O', 'T', 'C', 'K', 'P' };
+inline static constexpr std::uint32_t checkpointVersion{ 2 };
+
+struct CheckpointHeader
+{
+    std::array< char, 8 > magic;
+    std::uint32_t version;
+    std::uint32_t realSize; // engine precision
+    std::uint64_t sceneHash;
+    std::uint32_t renderingPass; // last completed one
+    std::uint32_t plateCount;
+    std::uint64_t texelTotal; // of every plate
+    std::uint64_t photonCount;
+};
+
+// FNV-1a over the values the transport depends on, the russian roulette included since its survivors change the lightmaps:
+std::uint64_t SceneHash( const Scene & _scene, const Plates & _plates, const std::vector< Photon< Real > > & _lightSources, const std::optional< Real > & _hierarchicalThreshold,
+    const std::optional< Real > & _rouletteThreshold, const std::size_t _photonBudget )
+{
+    std::uint64_t hash{ 14695981039346656037ull };
+    const auto Hash{ [ & ]( const auto & _value ) {
+            const auto * const pBytes{ reinterpret_cast< const unsigned char * >( &_value ) };
+            for( std::size_t i{ 0 }; i < sizeof( _value ); ++i )
+                hash = ( hash ^ pBytes[ i ] ) * 1099511628211ull;
+        } };
+    Hash( _scene.plateWidth ); Hash( _scene.textureWidth ); Hash( _scene.materialRetransmission ); Hash( _scene.wavelengthDecayDistance ); Hash( _scene.wavelengthDecay );
+    for( const auto & plate : _plates ) {
+        Hash( plate.positions ); Hash( plate.normal ); Hash( plate.material.color ); Hash( plate.material.retransmission );
+    }
+    for( const auto & lightSource : _lightSources ) {
+        Hash( lightSource.position ); Hash( lightSource.normal ); Hash( lightSource.color );
+    }
+    Hash( _hierarchicalThreshold.value_or( -1 ) );
+    Hash( _rouletteThreshold.value_or( -1 ) );
+    Hash( _photonBudget );
+    return hash;
+}
+
+// streamed section by section from the engine buffers, to a temporary file renamed once complete:
+template< typename T >
+bool WriteCheckpoint( const char * _path, const CheckpointHeader & _header, const TexelAtlas< T > & _atlas,
+    const std::vector< unsigned > & _photonIndices, const std::vector< Photon< T > > & _photons )
+{
+    static_assert( std::is_trivially_copyable_v< Photon< T > > );
+    const std::string temporaryPath{ std::string{ _path } + ".tmp" };
+    {
+        std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+        const auto Write{ [ & ]( const auto * _pData, const std::size_t _count ) {
+                file.write( reinterpret_cast< const char * >( _pData ), static_cast< std::streamsize >( _count * sizeof( *_pData ) ) );
+            } };
+        Write( &_header, 1 );
+        Write( _atlas.receivers.x.data(), _header.texelTotal );
+        Write( _atlas.receivers.y.data(), _header.texelTotal );
+        Write( _atlas.receivers.z.data(), _header.texelTotal );
+        Write( _photonIndices.data(), _photonIndices.size() );
+        Write( _photons.data(), _photons.size() );
+        file.close();
+        if( !file )
+            return false;
+    }
+    std::error_code error;
+    std::filesystem::rename( temporaryPath, _path, error );
+    return !error;
+}
+
+// streamed straight into the engine buffers, returns the last completed pass, nothing when the checkpoint does not match:
+template< typename T >
+std::optional< unsigned > ReadCheckpoint( const char * _path, const std::uint64_t _sceneHash, TexelAtlas< T > & _atlas,
+    std::vector< unsigned > & _photonIndices, std::vector< Photon< T > > & _photons )
+{
+    std::ifstream file{ _path, std::ios::binary };
+    const auto Read{ [ & ]( auto * _pData, const std::size_t _count ) {
+            file.read( reinterpret_cast< char * >( _pData ), static_cast< std::streamsize >( _count * sizeof( *_pData ) ) );
+        } };
+    CheckpointHeader header;
+    Read( &header, 1 );
+    const auto texelTotal{ _atlas.offsets.back() };
+    if( !file || header.magic != checkpointMagic || header.version != checkpointVersion || header.realSize != sizeof( T ) || header.sceneHash != _sceneHash
+        || header.plateCount != _atlas.plates.size() || header.texelTotal != texelTotal )
+        return std::nullopt;
+    Read( _atlas.receivers.x.data(), texelTotal );
+    Read( _atlas.receivers.y.data(), texelTotal );
+    Read( _atlas.receivers.z.data(), texelTotal );
+    _photonIndices.resize( texelTotal );
+    Read( _photonIndices.data(), _photonIndices.size() );
+    _photons.resize( header.photonCount );
+    Read( _photons.data(), _photons.size() );
+    if( !file )
+        return std::nullopt;
+    return header.renderingPass;
+}
+
+// the plates have the scene texture width unless their own widths are given, for the generic engine only:
+template< typename T, unsigned TextureWidth >
+TexelAtlas< T > PrepareTexels( const Scene & _scene, const Plates & _plates, const std::vector< unsigned > * _pPlateWidths = nullptr )
+{
+    const auto PlateTextureWidth{ [ & ]( const std::size_t _plateIndex ) {
+            return _pPlateWidths != nullptr ? ( *_pPlateWidths )[ _plateIndex ] : SpecializedWidth< TextureWidth >( _scene.textureWidth );
+        } };
+    TexelAtlas< T > atlas;
+    atlas.offsets.assign( _plates.size() + 1, 0 );
+    for( std::size_t plateIndex{ 0 }; plateIndex < _plates.size(); ++plateIndex )
+        atlas.offsets[ plateIndex + 1 ] = atlas.offsets[ plateIndex ] + std::size_t{ PlateTextureWidth( plateIndex ) } * PlateTextureWidth( plateIndex );
+
+    // init and reset receiver and emitter buffers, a single allocation each for every plate:
+    VecArrayReset( atlas.receivers, atlas.offsets.back() );
+    VecArrayReset( atlas.emitters, atlas.offsets.back() );
+    VecArrayReset( atlas.positions, atlas.offsets.back() );
+    atlas.plates.resize( _plates.size() );
+    std::for_each( std::execution::par_unseq, atlas.plates.begin(), atlas.plates.end(), [ & ]( auto & _plateTexels ) {
+        const auto plateIndex{ static_cast< std::size_t >( &_plateTexels - atlas.plates.data() ) };
+        const auto & plate{ _plates[ plateIndex ] };
+        const auto offset{ atlas.offsets[ plateIndex ] };
+        const auto size{ atlas.offsets[ plateIndex + 1 ] - offset };
+        const auto width{ PlateTextureWidth( plateIndex ) };
+        _plateTexels = { VecArraySpan( atlas.positions, offset, size ), VecArraySpan( atlas.emitters, offset, size ), VecArraySpan( atlas.receivers, offset, size ), width, offset };
+
+        // precompute positions of each texture point in 3D:
+        std::size_t texel{ 0 };
+        for( unsigned int y{ 0 }; y < width; ++y )
+            for( unsigned int x{ 0 }; x < width; ++x, ++texel )
+                VecArraySet( _plateTexels.positions, texel, VecCast< T >( TexelPosition( plate, x, y, width ) ) );
+    } );
+    return atlas;
+}
+
+// initial photons list, the light sources sampled at the texture resolution:
+template< typename T >
+std::vector< Photon< T > > LightPhotons( const Scene & _scene, const std::vector< Photon< Real > > & _lightSources )
+{
+    std::vector< Photon< T > > photons;
+    const auto lightResolution{ Real{ 1 } / std::pow( _scene.textureWidth, 2 ) };
+    const auto textureWidth{ static_cast< Real >( _scene.textureWidth ) };
+    const auto halfPlateWidth{ _scene.plateWidth / 2 };
+    for( const auto & lightSource : _lightSources ) {
+        const auto & position{ lightSource.position };
+        const auto color{ VecCast< T >( VecMult( lightSource.color, realMultiplier * lightResolution ) ) };
+        for( unsigned y{ 0 }; y < _scene.textureWidth; ++y ) {
+            const auto shiftY{ ( static_cast< Real >( y ) * _scene.plateWidth / textureWidth ) - halfPlateWidth };
+            for( unsigned x{ 0 }; x < _scene.textureWidth; ++x ) {
+                const auto shiftX{ ( static_cast< Real >( x ) * _scene.plateWidth / textureWidth ) - halfPlateWidth };
+                photons.emplace_back( Photon< T >{ VecAdd( VecMult( position, _scene.plateWidth ), Vector3D{ shiftX, shiftY, 0 } ), VecCast< T >( lightSource.normal ), color } );
+            }
+        }
+    }
+    return photons;
+}
+
+// counter-based generator (Philox4x32-10): the four words drawn for a counter only depend on the counter and on the key,
+// so that a sample keyed by its indices draws the same numbers whatever the thread and the order it runs in:
+struct Philox
+{
+    using Counter = std::array< std::uint32_t, 4 >;
+    using Key = std::array< std::uint32_t, 2 >;
+
+    static Counter Generate( Counter _counter, Key _key )
+    {
+        for( int round{ 0 }; round < 10; ++round ) {
+            if( round != 0 ) {
+                _key[ 0 ] += 0x9E3779B9u;
+                _key[ 1 ] += 0xBB67AE85u;
+            }
+            const auto product0{ std::uint64_t{ 0xD2511F53u } * _counter[ 0 ] };
+            const auto product1{ std::uint64_t{ 0xCD9E8D57u } * _counter[ 2 ] };
+            _counter = { static_cast< std::uint32_t >( product1 >> 32 ) ^ _counter[ 1 ] ^ _key[ 0 ], static_cast< std::uint32_t >( product1 ),
+                         static_cast< std::uint32_t >( product0 >> 32 ) ^ _counter[ 3 ] ^ _key[ 1 ], static_cast< std::uint32_t >( product0 ) };
+        }
+        return _counter;
+    }
+
+    // in ]0, 1[:
+    static Real Uniform( const std::uint32_t _word )
+    {
+        return ( static_cast< Real >( _word ) + Real{ 0.5 } ) / Real{ 4294967296.0 };
+    }
+};
+
+// russian roulette on the emitters: one whose energy is below the threshold survives with a probability proportional to its energy
+// and carries the threshold energy then, so that the expected emitted energy is unchanged:
+struct PhotonRoulette
+{
+    Real threshold; // fraction of the mean emitter energy
+    std::size_t budget; // expected photon count, the threshold being raised to meet it, none when 0
+    unsigned seed;
+};
+
+// smallest threshold whose expected survivor count is the budget: the k largest energies survive for sure and the energy left
+// spreads over the budget - k other survivors, the energies being sorted, there being more of them than the budget:
+inline static Real RouletteBudgetThreshold( std::vector< Real > & _energies, const std::size_t _budget )
+{
+    std::sort( _energies.begin(), _energies.end(), std::greater<>{} );
+    auto remaining{ std::accumulate( _energies.begin(), _energies.end(), Real{ 0 } ) };
+    for( std::size_t k{ 0 }; k < _budget; ++k ) {
+        const auto threshold{ remaining / static_cast< Real >( _budget - k ) };
+        if( threshold > _energies[ k ] )
+            return threshold;
+        remaining -= _energies[ k ];
+    }
+    return _energies[ _budget - 1 ];
+}
+
+// the texels which received energy during a pass are the photons of the next one, indexed by texel, unless they lose the roulette:
+inline static constexpr unsigned noPhoton{ std::numeric_limits< unsigned >::max() };
+
+// emitters converted plate by plate in parallel: the photons of every plate are counted as soon as its emitters are final, the counts
+// are scanned into the first photon of every plate, then every plate writes its photons from there, in the order of a serial
+// conversion, and resets its emitters; the survival draw of the roulette only depends on the texel and on the pass:
+template< typename T, unsigned TextureWidth >
+struct PhotonCompaction
+{
+    const Transport< T > & transport;
+    TexelAtlas< T > & atlas;
+    std::vector< T > lightResolutions; // texel share of the plate area, per plate
+    const PhotonRoulette * pRoulette{ nullptr }; // of the pass being converted
+    Real threshold{ 0 };
+    std::vector< std::size_t > photonCounts;
+    std::vector< std::size_t > firstPhotons; // scanned photon counts, the photons of plate i being [ firstPhotons[ i ], firstPhotons[ i + 1 ] )
+    std::vector< std::size_t > culledCounts; // texels which received energy but are not emitted
+    std::vector< std::uint8_t > counted;
+
+    PhotonCompaction( const Transport< T > & _transport, TexelAtlas< T > & _atlas ) : transport{ _transport }, atlas{ _atlas },
+        photonCounts( _atlas.plates.size(), 0 ), firstPhotons( _atlas.plates.size() + 1, 0 ), culledCounts( _atlas.plates.size(), 0 ), counted( _atlas.plates.size(), 0 )
+    {
+        for( const auto & plateTexels : _atlas.plates )
+            lightResolutions.emplace_back( static_cast< T >( Real{ 1 } / std::pow( SpecializedWidth< TextureWidth >( plateTexels.width ), 2 ) ) );
+    }
+
+    std::optional< Vector3< T > > EmitterColor( const std::size_t _plateIndex, const std::size_t _texel ) const
+    {
+        const auto color{ VecMult( VecArrayGet( atlas.plates[ _plateIndex ].emitters, _texel ), lightResolutions[ _plateIndex ] ) };
+        if( color[ 0 ] > std::numeric_limits< T >::min() && color[ 1 ] > std::numeric_limits< T >::min() && color[ 2 ] > std::numeric_limits< T >::min() )
+            return color;
+        return std::nullopt;
+    }
+
+    std::optional< Vector3< T > > PhotonColor( const std::size_t _plateIndex, const std::size_t _texel ) const
+    {
+        auto color{ EmitterColor( _plateIndex, _texel ) };
+        if( !color || pRoulette == nullptr )
+            return color;
+        const auto energy{ Energy( *color ) };
+        if( energy >= threshold )
+            return color;
+        const auto texel{ atlas.offsets[ _plateIndex ] + _texel };
+        const auto draw{ Philox::Generate( { static_cast< std::uint32_t >( texel ), static_cast< std::uint32_t >( texel >> 32 ), 0, 0 }, { pRoulette->seed, 0x524F554Cu } ) };
+        if( Philox::Uniform( draw[ 0 ] ) * threshold >= energy )
+            return std::nullopt;
+        return VecMult( *color, static_cast< T >( threshold / energy ) );
+    }
+
+    // once the emitters of the plate are final, the roulette threshold being known:
+    void Count( const std::size_t _plateIndex )
+    {
+        std::size_t photonCount{ 0 };
+        std::size_t culledCount{ 0 };
+        const auto & emitters{ atlas.plates[ _plateIndex ].emitters };
+        for( std::size_t texel{ 0 }; texel < emitters.x.size(); ++texel ) {
+            if( PhotonColor( _plateIndex, texel ) )
+                ++photonCount;
+            else
+            if( const auto emitter{ VecArrayGet( emitters, texel ) }; emitter[ 0 ] + emitter[ 1 ] + emitter[ 2 ] > 0 )
+                ++culledCount;
+        }
+        photonCounts[ _plateIndex ] = photonCount;
+        culledCounts[ _plateIndex ] = culledCount;
+        counted[ _plateIndex ] = 1;
+    }
+
+    void ScanCounts()
+    {
+        firstPhotons.front() = 0;
+        std::partial_sum( photonCounts.begin(), photonCounts.end(), firstPhotons.begin() + 1 );
+    }
+
+    // photons of every plate found back from the photon indices, as read from a checkpoint:
+    void Recount( const std::vector< unsigned > & _photonIndices )
+    {
+        for( std::size_t plateIndex{ 0 }; plateIndex < atlas.plates.size(); ++plateIndex )
+            photonCounts[ plateIndex ] = static_cast< std::size_t >( std::count_if( _photonIndices.begin() + static_cast< std::ptrdiff_t >( atlas.offsets[ plateIndex ] ),
+                _photonIndices.begin() + static_cast< std::ptrdiff_t >( atlas.offsets[ plateIndex + 1 ] ), []( const unsigned _photonIndex ) { return _photonIndex != noPhoton; } ) );
+        ScanCounts();
+    }
+
+    void Scatter( const std::size_t _plateIndex, std::vector< Photon< T > > & _photons, std::vector< unsigned > & _photonIndices )
+    {
+        const auto & plate{ transport.plates[ _plateIndex ] };
+        auto & plateTexels{ atlas.plates[ _plateIndex ] };
+        auto photon{ firstPhotons[ _plateIndex ] };
+        auto itPhotonIndex{ _photonIndices.begin() + static_cast< std::ptrdiff_t >( atlas.offsets[ _plateIndex ] ) };
+        if( photonCounts[ _plateIndex ] == 0 && culledCounts[ _plateIndex ] == 0 ) {
+            std::fill_n( itPhotonIndex, plateTexels.emitters.x.size(), noPhoton ); // dark plate, its emitters are clear already
+            return;
+        }
+        for( std::size_t texel{ 0 }; texel < plateTexels.emitters.x.size(); ++texel, ++itPhotonIndex ) {
+            const auto color{ PhotonColor( _plateIndex, texel ) };
+            if( !color ) {
+                *itPhotonIndex = noPhoton;
+                continue;
+            }
+            *itPhotonIndex = static_cast< unsigned >( photon );
+            _photons[ photon++ ] = Photon< T >{ EmitterPhotonPosition( GeometryTexelPosition< T, TextureWidth >( transport, plateTexels, _plateIndex, texel ), plate.normal ),
+                VecCast< T >( plate.normal ), *color };
+        }
+        VecArrayClear( plateTexels.emitters ); // reset for next round
+    }
+};
+
+// roulette energy threshold, from the mean emitter energy and the budget, the energies being gathered plate by plate:
+template< typename T, unsigned TextureWidth >
+Real RouletteThreshold( const PhotonCompaction< T, TextureWidth > & _compaction, const PhotonRoulette & _roulette, TaskPool & _pool )
+{
+    const auto plateCount{ _compaction.atlas.plates.size() };
+    std::vector< std::size_t > firstEnergies( plateCount + 1, 0 );
+    const auto ForEachEnergy{ [ & ]( const std::size_t _plateIndex, const auto & _Function ) {
+            for( std::size_t texel{ 0 }; texel < _compaction.atlas.plates[ _plateIndex ].emitters.x.size(); ++texel )
+                if( const auto color{ _compaction.EmitterColor( _plateIndex, texel ) } )
+                    _Function( Energy( *color ) );
+        } };
+    _pool.Run( plateCount, [ & ]( const std::size_t _plateIndex ) {
+        ForEachEnergy( _plateIndex, [ & ]( const Real ) { ++firstEnergies[ _plateIndex + 1 ]; } );
+    } );
+    std::partial_sum( firstEnergies.begin(), firstEnergies.end(), firstEnergies.begin() );
+    std::vector< Real > energies( firstEnergies.back() );
+    _pool.Run( plateCount, [ & ]( const std::size_t _plateIndex ) {
+        auto itEnergy{ energies.begin() + static_cast< std::ptrdiff_t >( firstEnergies[ _plateIndex ] ) };
+        ForEachEnergy( _plateIndex, [ & ]( const Real _energy ) { *itEnergy++ = _energy; } );
+    } );
+    if( energies.empty() )
+        return 0;
+    auto threshold{ _roulette.threshold * std::accumulate( energies.begin(), energies.end(), Real{ 0 } ) / static_cast< Real >( energies.size() ) };
+    if( _roulette.budget != 0 && energies.size() > _roulette.budget )
+        threshold = std::max( threshold, RouletteBudgetThreshold( energies, _roulette.budget ) );
+    return threshold;
+}
+
+// the plates not counted during the pass are counted here, the photons are written to the spare buffer which is swapped with the
+// photon list then, returns the count of texels which received energy but are not emitted:
+template< typename T, unsigned TextureWidth >
+std::size_t EmittersToPhotons( PhotonCompaction< T, TextureWidth > & _compaction, std::vector< Photon< T > > & _photons, std::vector< Photon< T > > & _spare,
+    std::vector< unsigned > & _photonIndices, TaskPool & _pool, const PhotonRoulette * _pRoulette = nullptr )
+{
+    const auto plateCount{ _compaction.atlas.plates.size() };
+    _compaction.pRoulette = _pRoulette;
+    _compaction.threshold = _pRoulette != nullptr ? RouletteThreshold( _compaction, *_pRoulette, _pool ) : 0;
+    _pool.Run( plateCount, [ & ]( const std::size_t _plateIndex ) {
+        if( _pRoulette != nullptr || _compaction.counted[ _plateIndex ] == 0 )
+            _compaction.Count( _plateIndex );
+    } );
+    _compaction.ScanCounts();
+    _spare.resize( _compaction.firstPhotons.back() );
+    _photonIndices.resize( _compaction.atlas.offsets.back() );
+    _pool.Run( plateCount, [ & ]( const std::size_t _plateIndex ) {
+        _compaction.Scatter( _plateIndex, _spare, _photonIndices );
+    } );
+    std::swap( _photons, _spare );
+    std::fill( _compaction.counted.begin(), _compaction.counted.end(), 0 );
+    _compaction.pRoulette = nullptr;
+    return std::accumulate( _compaction.culledCounts.begin(), _compaction.culledCounts.end(), std::size_t{ 0 } );
+}
+
+// transport kernels micro-benchmark, shooting the light source photons at every plate from a single thread, without occlusion:
+template< typename T, unsigned TextureWidth >
+void BenchKernels( const Scene & _scene, const Plates & _plates, const std::vector< Photon< Real > > & _lightSources, const KernelIsa _supportedIsa )
+{
+    const auto transport{ MakeTransport< T >( _scene, _plates, nullptr ) };
+    const auto photons{ LightPhotons< T >( _scene, _lightSources ) };
+    const auto texelCount{ _scene.textureWidth * _scene.textureWidth };
+    Vector3Array< T > scalarReceivers;
+    for( int isa{ static_cast< int >( KernelIsa::scalar ) }; isa <= static_cast< int >( _supportedIsa ); ++isa ) {
+        const auto Kernel{ SelectTransportKernel< T, TextureWidth >( static_cast< KernelIsa >( isa ) ) };
+        auto atlas{ PrepareTexels< T, TextureWidth >( _scene, _plates ) };
+        auto & texels{ atlas.plates };
+        const auto tBench{ std::chrono::high_resolution_clock::now() };
+        for( std::size_t plateIndex{ 0 }; plateIndex < _plates.size(); ++plateIndex )
+            for( const auto & photon : photons )
+                for( std::size_t tile{ 0 }; tile < TileCount( texelCount ); ++tile )
+                    Kernel( transport, texels[ plateIndex ], plateIndex, photon, TileTarget( texels[ plateIndex ], tile ) );
+        const auto benchDuration{ std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tBench ).count() };
+        const auto texelTotal{ static_cast< double >( photons.size() ) * static_cast< double >( _plates.size() ) * texelCount };
+        std::cout << KernelIsaName( static_cast< KernelIsa >( isa ) ) << " kernel: " << texelTotal / benchDuration / 1000000 << " Mtexels/s";
+        if( isa == static_cast< int >( KernelIsa::scalar ) )
+            scalarReceivers = atlas.receivers;
+        else {
+            T maxDifference{ 0 };
+            for( std::size_t texel{ 0 }; texel < atlas.offsets.back(); ++texel )
+                for( int i{ 0 }; i < 3; ++i )
+                    maxDifference = std::max( maxDifference, std::abs( VecArrayGet( atlas.receivers, texel )[ i ] - VecArrayGet( scalarReceivers, texel )[ i ] ) );
+            std::cout << ", max difference to scalar: " << maxDifference;
+        }
+        std::cout << std::endl;
+    }
+}
+
+// photon transport, every rendering pass shooting the photons of the previous one at every plate,
+// the texel visibility cache being built on the second pass unless one is given:
+template< typename T, unsigned TextureWidth >
+Lightmaps Solve( const Scene & _scene, const Plates & _plates, const Occlusion & _occlusion, const std::vector< Photon< Real > > & _lightSources,
+    const unsigned _maxRenderingPass, const Options & _options, const VisibilityCache< T > * _pVisibilityCache = nullptr )
+{
+    const auto transport{ MakeTransport< T >( _scene, _plates, &_occlusion ) };
+    const auto ShootPhoton{ SelectTransportKernel< T, TextureWidth >( _options.kernelIsa ) };
+    auto atlas{ [ & ]{
+            ScopedTimer timer{ _options.pTrace, "prepare texels" };
+            return PrepareTexels< T, TextureWidth >( _scene, _plates, _options.pPlateWidths );
+        }() };
+    auto & texels{ atlas.plates };
+    const auto TexelCount{ [ & ]( const std::size_t _plateIndex ) { return atlas.offsets[ _plateIndex + 1 ] - atlas.offsets[ _plateIndex ]; } };
+    auto photons{ LightPhotons< T >( _scene, _lightSources ) };
+    TaskPool pool{ _options.threadCount };
+
+    // a worker process of the sharded solve only shoots at its own plates, every plate being a source still:
+    const auto receivingPlates{ _options.pShard != nullptr ? _options.pShard->Plates() : PlateRange{ 0, _plates.size() } };
+
+    // next photon list, swapped with the current one every pass, the photons of a plate being counted by the task completing it
+    // unless the roulette threshold has to be known first:
+    std::vector< Photon< T > > nextPhotons;
+    PhotonCompaction< T, TextureWidth > compaction{ transport, atlas };
+    const bool useRoulette{ _options.rouletteThreshold.has_value() || _options.photonBudget != 0 };
+
+    // progress bar over the tasks of a pass, drawn by the worker completing a new percent unless another one is drawing,
+    // no worker ever waiting for it:
+    std::size_t taskCount{ 0 };
+    std::atomic< std::size_t > taskCompleted{ 0 };
+    std::atomic< std::size_t > drawnPercent{ 0 };
+    std::atomic_flag drawing;
+    static constexpr unsigned barLength{ 50 };
+    static constexpr unsigned barLengthMargin{ barLength + 7 };
+    const auto Draw{ []( const unsigned _length, const char _char ){ for( unsigned i{ 0 }; i < _length; ++i ) std::cout << _char; } };
+    const auto DrawBar{ [ & ]( const std::size_t _percent ) {
+            Draw( barLengthMargin, '\r' );
+            const auto length{ static_cast< unsigned >( _percent * barLength / 100 ) };
+            std::cout << "[";
+            Draw( length, 'O' );
+            Draw( barLength - length, ' ' );
+            std::cout << "] " << _percent << "%" << std::flush;
+        } };
+    const auto Progress{ [ & ]{
+            if( !_options.verbose )
+                return;
+            const auto percent{ ( taskCompleted.fetch_add( 1, std::memory_order_relaxed ) + 1 ) * 100 / taskCount };
+            if( percent <= drawnPercent.load( std::memory_order_relaxed ) || drawing.test_and_set( std::memory_order_acquire ) )
+                return;
+            if( percent > drawnPercent.load( std::memory_order_relaxed ) ) {
+                drawnPercent.store( percent, std::memory_order_relaxed );
+                DrawBar( percent );
+            }
+            drawing.clear( std::memory_order_release );
+        } };
+    const auto RunTasks{ [ & ]( const std::size_t _taskCount, const std::function< void( std::size_t ) > & _Task ) {
+            taskCount = _taskCount;
+            taskCompleted = 0;
+            drawnPercent = 0;
+            if( _options.verbose )
+                DrawBar( 0 );
+            pool.Run( _taskCount, _Task );
+            if( _options.verbose ) {
+                Draw( barLengthMargin, '\r' ); Draw( barLengthMargin, ' ' ); Draw( barLengthMargin, '\r' );
+            }
+        } };
+
+    // from the second pass on, photons are emitter texels, indexed here by texel to be found back from the cache:
+    std::optional< VisibilityCache< T > > visibilityCache;
+    const VisibilityCache< T > * pVisibilityCache{ _pVisibilityCache };
+    bool visibilityCacheTried{ _pVisibilityCache != nullptr };
+    std::vector< unsigned > photonIndices;
+
+    // plate pairs which cannot exchange energy, the photons of a pass being grouped by source plate then:
+    std::optional< PlateVisibilitySet > plateVisibility;
+
+    // emitter pyramids and receiver bounding spheres, for the hierarchical mode:
+    const auto & hierarchicalThreshold{ _options.hierarchicalThreshold };
+    std::vector< EmitterPyramid< T > > emitterPyramids;
+    std::vector< std::pair< Vector3D, Real > > receiverSpheres;
+    if( hierarchicalThreshold ) {
+        for( const auto & plate : _plates ) {
+            emitterPyramids.emplace_back( BuildEmitterPyramid< T >( plate, texels[ emitterPyramids.size() ].width ) );
+            const auto center{ VecMult( VecAdd( VecAdd( plate.positions[ 0 ], plate.positions[ 1 ] ), VecAdd( plate.positions[ 2 ], plate.positions[ 3 ] ) ), Real{ 0.25 } ) };
+            receiverSpheres.emplace_back( center, VecDist( center, plate.positions[ 0 ] ) );
+        }
+    }
+
+    // tile of a plate published to the viewer once a pass completes it, scaled back as the lightmaps are:
+    const auto Publish{ [ & ]( const std::size_t _plateIndex ) {
+            if( _options.pPreview == nullptr )
+                return;
+            const auto & receivers{ texels[ _plateIndex ].receivers };
+            _options.pPreview->Publish( _plateIndex, texels[ _plateIndex ].width, [ & ]( const std::size_t _texel ) {
+                    const auto receiver{ VecCast< Real >( VecArrayGet( receivers, _texel ) ) };
+                    return Vector3D{ receiver[ 0 ] / realMultiplier, receiver[ 1 ] / realMultiplier, receiver[ 2 ] / realMultiplier };
+                } );
+        } };
+
+    // private accumulators of the photon chunks but the first one, chunk after chunk, plate after plate:
+    Vector3Array< T > chunkReceivers;
+    Vector3Array< T > chunkEmitters;
+
+    // rendering pass for each photo list:
+    unsigned renderingPass{ 0 };
+    auto maxRenderingPass{ _maxRenderingPass };
+    const auto sceneHash{ SceneHash( _scene, _plates, _lightSources, hierarchicalThreshold, _options.rouletteThreshold, _options.photonBudget ) };
+    if( _options.resume && _options.pCheckpointPath != nullptr ) {
+        const auto resumedPass{ ReadCheckpoint( _options.pCheckpointPath, sceneHash, atlas, photonIndices, photons ) };
+        if( resumedPass ) {
+            renderingPass = *resumedPass;
+            compaction.Recount( photonIndices );
+            for( std::size_t plateIndex{ 0 }; plateIndex < _plates.size(); ++plateIndex )
+                Publish( plateIndex );
+            if( _options.verbose )
+                std::cout << "resumed after pass " << renderingPass << " from " << _options.pCheckpointPath << std::endl;
+        }
+        else {
+            // a partial read may have overwritten the initial state:
+            atlas = PrepareTexels< T, TextureWidth >( _scene, _plates, _options.pPlateWidths );
+            photons = LightPhotons< T >( _scene, _lightSources );
+            photonIndices.clear();
+            if( _options.verbose )
+                std::cout << "no checkpoint matching this scene in " << _options.pCheckpointPath << ", starting over" << std::endl;
+        }
+    }
+    if( _options.morePasses )
+        maxRenderingPass = renderingPass + *_options.morePasses;
+
+    std::uint64_t photonTotal{ 0 };
+    while( !photons.empty() && renderingPass < maxRenderingPass ) {
+        ++renderingPass;
+        photonTotal += photons.size();
+        ScopedTimer passTimer{ _options.pTrace, "pass " + std::to_string( renderingPass ) };
+        if( _options.verbose )
+            std::cout << "pass " << renderingPass << "/" << maxRenderingPass << " - " << photons.size() << " photon(s)" << std::endl;
+
+        // sum the emitter energies up each plate pyramid:
+        const bool useHierarchy{ renderingPass > 1 && hierarchicalThreshold.has_value() };
+        Real maxPlateEnergy{ 0 };
+        if( useHierarchy ) {
+            std::for_each( std::execution::par_unseq, emitterPyramids.begin(), emitterPyramids.end(), [ & ]( auto & _pyramid ) {
+                const auto plateIndex{ static_cast< std::size_t >( &_pyramid - emitterPyramids.data() ) };
+                const auto firstTexel{ atlas.offsets[ plateIndex ] };
+                UpdateEmitterPyramid( _pyramid, texels[ plateIndex ].width, [ & ]( const unsigned _texel ) {
+                        const auto photonIndex{ photonIndices[ firstTexel + _texel ] };
+                        return photonIndex == noPhoton ? Vector3< T >{ 0, 0, 0 } : photons[ photonIndex ].color;
+                    } );
+            } );
+            for( const auto & pyramid : emitterPyramids )
+                maxPlateEnergy = std::max( maxPlateEnergy, Energy( pyramid.colors.back().front() ) );
+        }
+        std::atomic< std::uint64_t > interactionCount{ 0 };
+
+        // build the plate visibility once, on the first pass whose photons are emitter texels, unless a texel visibility cache is given:
+        if( renderingPass > 1 && !plateVisibility && pVisibilityCache == nullptr && _options.plateCulling && _plates.size() <= maxVisibilityPlates ) {
+            ScopedTimer visibilityTimer{ _options.pTrace, "plate visibility" };
+            const auto tVisibility{ std::chrono::high_resolution_clock::now() };
+            plateVisibility = BuildPlateVisibility< T >( _plates, _occlusion, receivingPlates, pool );
+            const auto visibilityDuration{ std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::high_resolution_clock::now() - tVisibility ) };
+            if( _options.verbose ) {
+                std::array< std::size_t, 3 > pairCounts{};
+                std::size_t listedCount{ 0 };
+                std::size_t listedOccluderCount{ 0 };
+                for( const auto & row : plateVisibility->rows )
+                    listedOccluderCount += row.occluders.size();
+                for( auto plateIndex{ receivingPlates.first }; plateIndex < receivingPlates.last; ++plateIndex ) {
+                    for( std::size_t sourcePlate{ 0 }; sourcePlate < _plates.size(); ++sourcePlate ) {
+                        ++pairCounts[ static_cast< std::size_t >( ( *plateVisibility )( plateIndex, sourcePlate ) ) ];
+                        listedCount += plateVisibility->Occluders( plateIndex, sourcePlate ).empty() ? 0 : 1;
+                    }
+                }
+                const auto pairTotal{ static_cast< double >( receivingPlates.size() * _plates.size() ) };
+                std::cout << "plate visibility: " << pairCounts[ 0 ] << " plate pair(s) culled (" << static_cast< double >( pairCounts[ 0 ] ) * 100 / pairTotal << "%), "
+                          << pairCounts[ 1 ] << " unoccluded, " << listedCount << " tested against their own occluders ("
+                          << static_cast< double >( listedOccluderCount ) / static_cast< double >( std::max< std::size_t >( listedCount, 1 ) ) << " on average), "
+                          << pairCounts[ 2 ] - listedCount << " against the tree, built in "
+                          << visibilityDuration.count() << "ms" << std::endl;
+            }
+        }
+        const auto * pPlateVisibility{ renderingPass > 1 && plateVisibility ? &*plateVisibility : nullptr };
+
+        // build texel visibility cache once, on the first pass whose photons are emitter texels:
+        if( renderingPass > 1 && !visibilityCacheTried && !hierarchicalThreshold ) {
+            visibilityCacheTried = true;
+            if( _options.cacheBudget == 0 ) {
+                if( _options.verbose )
+                    std::cout << "visibility cache disabled, tracing on the fly" << std::endl;
+            }
+            else {
+                ScopedTimer cacheTimer{ _options.pTrace, "visibility cache" };
+                const auto tCache{ std::chrono::high_resolution_clock::now() };
+                visibilityCache = BuildVisibilityCache< T, TextureWidth >( transport, texels, _options.cacheBudget * 1024 * 1024, pPlateVisibility, receivingPlates, pool );
+                pVisibilityCache = visibilityCache ? &*visibilityCache : nullptr;
+                const auto cacheDuration{ std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::high_resolution_clock::now() - tCache ) };
+                if( _options.verbose ) {
+                    if( visibilityCache )
+                        std::cout << "visibility cache: " << visibilityCache->entryCount << " visible texel pair(s), "
+                                  << visibilityCache->entryCount * sizeof( typename VisibilityCache< T >::Entry ) / ( 1024 * 1024 ) << "MB, built in " << cacheDuration.count() << "ms" << std::endl;
+                    else
+                        std::cout << "visibility cache exceeds " << _options.cacheBudget << "MB budget, tracing on the fly" << std::endl;
+                }
+            }
+        }
+        const bool useVisibilityCache{ renderingPass > 1 && pVisibilityCache != nullptr };
+
+        // sparse product of the cached transport terms with the photon energies, plate by plate:
+        if( useVisibilityCache ) {
+            RunTasks( receivingPlates.size(), [ & ]( const std::size_t _task ) {
+                const auto plateIndex{ receivingPlates.first + _task };
+                auto & plateTexels{ texels[ plateIndex ] };
+                const auto & material{ _plates[ plateIndex ].material };
+                const auto materialColor{ VecCast< T >( material.color ) };
+                const auto retransmission{ static_cast< T >( material.retransmission ) };
+                for( const auto & entry : pVisibilityCache->plates[ plateIndex ] ) {
+                    const auto photonIndex{ photonIndices[ entry.source ] };
+                    if( photonIndex == noPhoton )
+                        continue; // emitter texel did not make it as a photon this pass
+                    const auto wavelengthDecay{ WavelengthDecay( transport.wavelengthDecay, entry.distanceFactor ) };
+                    const auto received{ VecMult( VecMult( VecMult( photons[ photonIndex ].color, materialColor ), wavelengthDecay ), entry.raySrcAngle ) };
+                    VecArraySet( plateTexels.receivers, entry.texel, VecAdd( VecArrayGet( plateTexels.receivers, entry.texel ), received ) );
+                    VecArraySet( plateTexels.emitters, entry.texel, VecAdd( VecArrayGet( plateTexels.emitters, entry.texel ), VecMult( received, retransmission ) ) ); // cumulated energy transmission
+                }
+                if( !useRoulette )
+                    compaction.Count( plateIndex );
+                Publish( plateIndex );
+                Progress();
+            } );
+        }
+        else {
+            // photons shot at each plate, every one of them or the emitter clusters selected for it:
+            std::vector< std::vector< Photon< T > > > clusterPhotons;
+            if( useHierarchy ) {
+                clusterPhotons.resize( _plates.size() );
+                pool.Run( receivingPlates.size(), [ & ]( const std::size_t _task ) {
+                    const auto plateIndex{ receivingPlates.first + _task };
+                    std::vector< Cluster > clusters;
+                    for( unsigned sourcePlate{ 0 }; sourcePlate < emitterPyramids.size(); ++sourcePlate )
+                        if( pPlateVisibility == nullptr || ( *pPlateVisibility )( plateIndex, sourcePlate ) != PlateVisibility::culled )
+                            SelectClusters( emitterPyramids[ sourcePlate ], sourcePlate, texels[ sourcePlate ].width, _scene.plateWidth,
+                                receiverSpheres[ plateIndex ].first, receiverSpheres[ plateIndex ].second, maxPlateEnergy, *hierarchicalThreshold, clusters );
+                    std::sort( clusters.begin(), clusters.end() ); // same photon order as the exact path when fully refined
+                    for( const auto & cluster : clusters ) {
+                        const auto & normal{ _plates[ cluster.plate ].normal };
+                        const auto & pyramid{ emitterPyramids[ cluster.plate ] };
+                        clusterPhotons[ plateIndex ].emplace_back( Photon< T >{ EmitterPhotonPosition( pyramid.positions[ cluster.level ][ cluster.index ], normal ), VecCast< T >( normal ), pyramid.colors[ cluster.level ][ cluster.index ] } );
+                    }
+                } );
+            }
+            const auto PlatePhotons{ [ & ]( const std::size_t _plateIndex ) -> const std::vector< Photon< T > > & {
+                    return useHierarchy ? clusterPhotons[ _plateIndex ] : photons;
+                } };
+
+            // photons of a range shot group by group of the same source plate, the groups the plate visibility culls being skipped,
+            // returns the count of photons skipped:
+            const auto ShootPhotonGroups{ [ & ]( const std::size_t _plateIndex, const std::size_t _firstPhoton, const std::size_t _lastPhoton, const auto & _Shoot ) -> std::size_t {
+                    if( pPlateVisibility == nullptr || useHierarchy ) {
+                        _Shoot( transport, _firstPhoton, _lastPhoton );
+                        return 0;
+                    }
+                    const auto & firstPhotons{ compaction.firstPhotons };
+                    std::size_t skippedCount{ 0 };
+                    auto sourcePlate{ static_cast< std::size_t >( std::upper_bound( firstPhotons.begin(), firstPhotons.end(), _firstPhoton ) - firstPhotons.begin() ) - 1 };
+                    for( ; sourcePlate < _plates.size() && firstPhotons[ sourcePlate ] < _lastPhoton; ++sourcePlate ) {
+                        const auto firstPhoton{ std::max( _firstPhoton, firstPhotons[ sourcePlate ] ) };
+                        const auto lastPhoton{ std::min( _lastPhoton, firstPhotons[ sourcePlate + 1 ] ) };
+                        if( firstPhoton >= lastPhoton )
+                            continue;
+                        const auto pairVisibility{ ( *pPlateVisibility )( _plateIndex, sourcePlate ) };
+                        if( pairVisibility == PlateVisibility::culled ) {
+                            skippedCount += lastPhoton - firstPhoton;
+                            continue;
+                        }
+
+                        // rays only tested against the occluders of the pair when they are few, not at all without any:
+                        auto occlusion{ _occlusion };
+                        if( const auto occluders{ pPlateVisibility->Occluders( _plateIndex, sourcePlate ) }; !occluders.empty() )
+                            occlusion.candidates = occluders;
+                        auto pairTransport{ transport };
+                        pairTransport.pOcclusion = pairVisibility == PlateVisibility::unoccluded ? nullptr : &occlusion;
+                        _Shoot( pairTransport, firstPhoton, lastPhoton );
+                    }
+                    return skippedCount;
+                } };
+
+            // (plate, tile, photon chunk) tasks, the first chunk of a tile accumulating in place and the others in private buffers:
+            std::size_t maxPhotonCount{ 0 };
+            for( auto plateIndex{ receivingPlates.first }; plateIndex < receivingPlates.last; ++plateIndex )
+                maxPhotonCount = std::max( maxPhotonCount, PlatePhotons( plateIndex ).size() );
+            if( _options.pShard != nullptr && useHierarchy && !_options.plateTasks ) {
+                const auto maxShardPhotons{ _options.pShard->MaxPlatePhotons( renderingPass, maxPhotonCount ) };
+                if( !maxShardPhotons )
+                    break;
+                maxPhotonCount = *maxShardPhotons;
+            }
+            // the tasks of a plate follow those of the plates before it, as many as its tiles times the chunks, the private buffers
+            // of a chunk holding the texels of every receiving plate:
+            const auto chunkCount{ _options.plateTasks ? 1 : PhotonChunkCount( maxPhotonCount ) };
+            const auto PlateTileCount{ [ & ]( const std::size_t _plateIndex ) { return _options.plateTasks ? 1 : TileCount( TexelCount( _plateIndex ) ); } };
+            std::vector< std::size_t > firstTasks( receivingPlates.size() + 1, 0 );
+            for( std::size_t receiver{ 0 }; receiver < receivingPlates.size(); ++receiver )
+                firstTasks[ receiver + 1 ] = firstTasks[ receiver ] + PlateTileCount( receivingPlates.first + receiver ) * chunkCount;
+            const auto chunkTexelCount{ atlas.offsets[ receivingPlates.last ] - atlas.offsets[ receivingPlates.first ] };
+            const auto ChunkOffset{ [ & ]( const std::size_t _chunk, const std::size_t _plateIndex ) {
+                    return ( _chunk - 1 ) * chunkTexelCount + atlas.offsets[ _plateIndex ] - atlas.offsets[ receivingPlates.first ];
+                } };
+            VecArrayReset( chunkReceivers, ( chunkCount - 1 ) * chunkTexelCount );
+            VecArrayReset( chunkEmitters, ( chunkCount - 1 ) * chunkTexelCount );
+            std::vector< std::atomic< std::size_t > > remainingTasks( _plates.size() );
+            for( auto plateIndex{ receivingPlates.first }; plateIndex < receivingPlates.last; ++plateIndex )
+                remainingTasks[ plateIndex ].store( PlateTileCount( plateIndex ) * chunkCount, std::memory_order_relaxed );
+            RunTasks( firstTasks.back(), [ & ]( const std::size_t _task ) {
+                const auto receiver{ static_cast< std::size_t >( std::upper_bound( firstTasks.begin(), firstTasks.end(), _task ) - firstTasks.begin() ) - 1 };
+                const auto plateIndex{ receivingPlates.first + receiver };
+                const auto plateTask{ _task - firstTasks[ receiver ] };
+                const auto chunk{ plateTask % chunkCount };
+                auto & plateTexels{ texels[ plateIndex ] };
+                const auto texelCount{ TexelCount( plateIndex ) };
+                const auto & platePhotons{ PlatePhotons( plateIndex ) };
+                const auto firstPhoton{ platePhotons.size() * chunk / chunkCount };
+                const auto lastPhoton{ platePhotons.size() * ( chunk + 1 ) / chunkCount };
+
+                // for each photon, for each texture point:
+                if( _options.plateTasks ) {
+                    interactionCount += platePhotons.size() * texelCount;
+                    pThreadCounters->pairsCulled += ShootPhotonGroups( plateIndex, 0, platePhotons.size(),
+                        [ & ]( const Transport< T > & _transport, const std::size_t _firstPhoton, const std::size_t _lastPhoton ) {
+                            for( auto photon{ _firstPhoton }; photon < _lastPhoton; ++photon )
+                                for( std::size_t tile{ 0 }; tile < TileCount( texelCount ); ++tile )
+                                    ShootPhoton( _transport, plateTexels, plateIndex, platePhotons[ photon ], TileTarget( plateTexels, tile ) );
+                        } );
+                }
+                else {
+                    const auto tile{ plateTask / chunkCount };
+                    auto target{ TileTarget( plateTexels, tile ) };
+                    if( chunk != 0 )
+                        target = ArrayTarget( chunkReceivers, chunkEmitters, ChunkOffset( chunk, plateIndex ) + target.firstTexel, target.firstTexel, target.lastTexel );
+                    interactionCount += ( lastPhoton - firstPhoton ) * ( target.lastTexel - target.firstTexel );
+                    const auto skippedCount{ ShootPhotonGroups( plateIndex, firstPhoton, lastPhoton,
+                        [ & ]( const Transport< T > & _transport, const std::size_t _firstPhoton, const std::size_t _lastPhoton ) {
+                            for( auto photon{ _firstPhoton }; photon < _lastPhoton; ++photon )
+                                ShootPhoton( _transport, plateTexels, plateIndex, platePhotons[ photon ], target );
+                        } ) };
+                    if( tile == 0 )
+                        pThreadCounters->pairsCulled += skippedCount; // counted once per plate
+                }
+
+                // the last task of the plate merges its private buffers chunk after chunk, whatever the order the tasks ran in,
+                // counts its photons and publishes its tile while the other plates are still being shot at:
+                if( remainingTasks[ plateIndex ].fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+                    for( std::size_t otherChunk{ 1 }; otherChunk < chunkCount; ++otherChunk ) {
+                        const auto offset{ ChunkOffset( otherChunk, plateIndex ) };
+                        for( std::size_t texel{ 0 }; texel < texelCount; ++texel ) {
+                            VecArraySet( plateTexels.receivers, texel, VecAdd( VecArrayGet( plateTexels.receivers, texel ), VecArrayGet( chunkReceivers, offset + texel ) ) );
+                            VecArraySet( plateTexels.emitters, texel, VecAdd( VecArrayGet( plateTexels.emitters, texel ), VecArrayGet( chunkEmitters, offset + texel ) ) );
+                        }
+                    }
+                    if( !useRoulette )
+                        compaction.Count( plateIndex );
+                    Publish( plateIndex );
+                }
+                Progress();
+            } );
+        }
+
+        if( useHierarchy && _options.verbose ) {
+            const auto exactCount{ static_cast< std::uint64_t >( photons.size() ) * atlas.offsets.back() };
+            std::cout << "photon-texel interaction(s): " << interactionCount << ", exact path: " << exactCount
+                      << " (" << static_cast< double >( interactionCount ) * 100 / static_cast< double >( exactCount ) << "%)" << std::endl;
+        }
+
+        // convert emitters to photons:
+        const auto pairCount{ static_cast< double >( photons.size() ) * static_cast< double >( _plates.size() ) };
+        auto counters{ pool.TakeCounters() };
         {
-            gl_Position = projection * view * model * vec4( aPos, 1.0 );
-            TexCoord = aTexCoord;
-        }
-    )_" };
-    ::glShaderSource( vertexShader, 1, &pVertexShaderSource, nullptr );
-    ::glCompileShader( vertexShader );
-
-    auto fragmentShader{ ::glCreateShader( GL_FRAGMENT_SHADER ) };
-    const char * pFragmentShaderSource{ R"_(
-        #version 330 core
-        in vec2 TexCoord;
-        out vec4 FragColor;
-
-        uniform sampler2D faceTexture;
-
-        void main() {
-            FragColor = texture( faceTexture, TexCoord );
-        }
-    )_" };
-    ::glShaderSource( fragmentShader, 1, &pFragmentShaderSource, nullptr );
-    ::glCompileShader( fragmentShader );
-
-    auto shaderProgram{ ::glCreateProgram() };
-    ::glAttachShader( shaderProgram, vertexShader );
-    ::glAttachShader( shaderProgram, fragmentShader );
-    ::glLinkProgram( shaderProgram );
-    ::glDeleteShader( vertexShader );
-    ::glDeleteShader( fragmentShader );
-
-    unsigned int vertexArray, verticesBufferObject, indicesBufferObject;
-    ::glGenVertexArrays( 1, &vertexArray );
-    ::glGenBuffers( 1, &verticesBufferObject );
-    ::glGenBuffers( 1, &indicesBufferObject );
-    
-    ::glBindVertexArray( vertexArray );
-    ::glBindBuffer( GL_ARRAY_BUFFER, verticesBufferObject );
-    ::glBufferData( GL_ARRAY_BUFFER, vertices.size() * sizeof( float ), vertices.data(), GL_STATIC_DRAW );
-    ::glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indicesBufferObject );
-    ::glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof( unsigned int ), indices.data(), GL_STATIC_DRAW );
-
-    ::glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof( float ), ( void * ) 0 );
-    ::glEnableVertexAttribArray( 0 );
-    ::glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof( float ), ( void * )( 3 * sizeof( float ) ) );
-    ::glEnableVertexAttribArray( 1 );
-
-    std::vector< unsigned int > textures;
-    textures.resize( plates.size() );
-    ::glGenTextures( static_cast< GLsizei >( textures.size() ), textures.data() );
-    for( int i{ 0 }; i < plates.size(); ++i ) {
-        ::glBindTexture( GL_TEXTURE_2D, textures[ i ] );
-        ::glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, scene.textureWidth, scene.textureWidth, 0, GL_RGB, GL_UNSIGNED_BYTE, plates[ i ].colors.data() );
-    }
-
-    const auto cameraDepth{ static_cast< float >( std::max( scene.width, scene.height ) * scene.plateWidth ) };
-    
-    ::glEnable( GL_DEPTH_TEST );
+            ScopedTimer conversionTimer{ _options.pTrace, "photon conversion" };
+            const PhotonRoulette roulette{ _options.rouletteThreshold.value_or( 0 ), _options.photonBudget, renderingPass };
+            counters.photonsCulled = EmittersToPhotons( compaction, photons, nextPhotons, photonIndices, pool, useRoulette ? &roulette : nullptr );
+            counters.photonsEmitted = photons.size();
+        }
+
+        // the photons of the other shards, in the same order as the photons of a single process:
+        if( _options.pShard != nullptr ) {
+            if( !_options.pShard->Exchange( renderingPass, photons, photonIndices ) )
+                break;
+            compaction.Recount( photonIndices );
+        }
+        if( _options.verbose ) {
+            std::cout << "facing rejection(s): " << counters.facingRejections << ", occlusion test(s): " << counters.occlusionTests;
+            if( counters.occlusionTests != 0 )
+                std::cout << " (" << static_cast< double >( counters.trianglesTested ) / static_cast< double >( counters.occlusionTests ) << " triangle(s) per ray, "
+                          << counters.raysBlocked * 100 / counters.occlusionTests << "% blocked)";
+            std::cout << ", photon(s) emitted: " << counters.photonsEmitted << ", culled: " << counters.photonsCulled;
+            if( counters.pairsCulled != 0 )
+                std::cout << ", (plate, photon) pair(s) culled: " << counters.pairsCulled << " (" << static_cast< double >( counters.pairsCulled ) * 100 / pairCount << "%)";
+            std::cout << std::endl;
+        }
+        passTimer.args = { { "facingRejections", static_cast< double >( counters.facingRejections ) }, { "occlusionTests", static_cast< double >( counters.occlusionTests ) },
+            { "trianglesTested", static_cast< double >( counters.trianglesTested ) }, { "raysBlocked", static_cast< double >( counters.raysBlocked ) },
+            { "photonsEmitted", static_cast< double >( counters.photonsEmitted ) }, { "photonsCulled", static_cast< double >( counters.photonsCulled ) },
+            { "pairsCulled", static_cast< double >( counters.pairsCulled ) } };
+
+        // snapshot of the completed pass:
+        if( _options.pCheckpointPath != nullptr ) {
+            const CheckpointHeader header{ checkpointMagic, checkpointVersion, sizeof( T ), sceneHash, renderingPass,
+                static_cast< std::uint32_t >( _plates.size() ), atlas.offsets.back(), photons.size() };
+            if( !WriteCheckpoint( _options.pCheckpointPath, header, atlas, photonIndices, photons ) )
+                std::cerr << "Failed to write checkpoint " << _options.pCheckpointPath << std::endl;
+        }
+    }
+
+    if( _options.verbose )
+        std::cout << "photon(s) shot: " << photonTotal << std::endl;
+
+    // scale the received energies back:
+    Lightmaps lightmaps{ atlas.offsets };
+    for( std::size_t texel{ 0 }; texel < atlas.offsets.back(); ++texel ) {
+        const auto receiver{ VecCast< Real >( VecArrayGet( atlas.receivers, texel ) ) };
+        VecArraySet( lightmaps.texels, texel, { receiver[ 0 ] / realMultiplier, receiver[ 1 ] / realMultiplier, receiver[ 2 ] / realMultiplier } );
+    }
+    return lightmaps;
+}
+
+// grazing cosine-weighted hits are clamped to this receiver angle, bounding their weight at the cost of a slight bias:
+inline static constexpr Real minReceiverAngle{ 0.01 };
+
+// stochastic transport: every pass shoots a fixed budget of random rays, every ray picking its photon in proportion to the photon energy,
+// then either a uniform texel of a uniform plate, the weighted deposit being an unbiased estimate of the exhaustive pass,
+// or a cosine-weighted direction up to the nearest plate, the deposit being weighted by the solid angle of the texel hit;
+// iterations running every pass are accumulated progressively so that the lightmaps refine with time, the random numbers of a ray
+// being keyed by (ray, pass, iteration) and the deposits summed in ray order so that the lightmaps do not depend on the thread count:
+template< typename T, unsigned TextureWidth >
+Lightmaps SolveMonteCarlo( const Scene & _scene, const Plates & _plates, const Occlusion & _occlusion, const std::vector< Photon< Real > > & _lightSources,
+    const unsigned _maxRenderingPass, const Options & _options )
+{
+    const auto transport{ MakeTransport< T >( _scene, _plates, &_occlusion ) };
+    const auto width{ SpecializedWidth< TextureWidth >( _scene.textureWidth ) };
+    const auto texelCount{ width * width };
+    const auto rayCount{ _options.monteCarloRays };
+    const auto sceneHash{ SceneHash( _scene, _plates, _lightSources, std::nullopt, std::nullopt, 0 ) };
+    const Philox::Key key{ static_cast< std::uint32_t >( sceneHash ), static_cast< std::uint32_t >( sceneHash >> 32 ) };
+    auto atlas{ [ & ]{
+            ScopedTimer timer{ _options.pTrace, "prepare texels" };
+            return PrepareTexels< T, TextureWidth >( _scene, _plates );
+        }() };
+    auto & texels{ atlas.plates };
+    TaskPool pool{ _options.threadCount };
+    if( _plates.empty() )
+        return Lightmaps{};
+
+    // texel areas, and a segment length leaving the scene bounds from wherever the ray starts:
+    std::vector< Real > texelAreas;
+    for( const auto & plate : _plates ) {
+        const auto cross{ VecCross( VecSub( plate.positions[ 1 ], plate.positions[ 0 ] ), VecSub( plate.positions[ 3 ], plate.positions[ 0 ] ) ) };
+        texelAreas.emplace_back( std::sqrt( VecDot( cross, cross ) ) / texelCount );
+    }
+    const auto & sceneBounds{ _occlusion.tree.nodes.front().bounds };
+
+    // the nearest plate is looked for among the receivers, the occlusion tree being built over the merged occluders:
+    const auto receiverQuads{ _options.raySampling == RaySampling::cosine && _occlusion.pPlateOccluders != nullptr ? PlateQuads( _plates ) : Quads{} };
+    const auto receiverTree{ BuildOcclusionTree( receiverQuads ) };
+    const auto & nearestTree{ receiverTree.nodes.empty() ? _occlusion.tree : receiverTree };
+    const auto & nearestQuads{ receiverTree.nodes.empty() ? _occlusion.quads : receiverQuads };
+    const auto sceneCenter{ VecMult( VecAdd( sceneBounds.min, sceneBounds.max ), Real{ 0.5 } ) };
+    const auto sceneRadius{ VecDist( sceneCenter, sceneBounds.max ) };
+
+    // deposit of every ray of a pass, written by the ray then summed plate by plate in ray order:
+    static constexpr unsigned noPlate{ std::numeric_limits< unsigned >::max() };
+    static constexpr std::size_t raysPerTask{ 1024 };
+    struct Deposit
+    {
+        unsigned plate; // none when the ray deposits nothing
+        unsigned texel;
+        Vector3< T > received;
+    };
+    std::vector< Deposit > deposits( rayCount );
+    std::vector< std::size_t > plateFirstDeposits( _plates.size() + 1 );
+    std::vector< std::size_t > depositOrder;
+    std::vector< unsigned > photonIndices;
+    std::vector< Real > cumulatedEnergies;
+    std::vector< Photon< T > > nextPhotons;
+    PhotonCompaction< T, TextureWidth > compaction{ transport, atlas };
+
+    const auto Shoot{ [ & ]( const std::vector< Photon< T > > & _photons, const unsigned _renderingPass, const unsigned _iteration, const std::size_t _ray ) -> Deposit {
+            const auto random{ Philox::Generate( { static_cast< std::uint32_t >( _ray ), static_cast< std::uint32_t >( static_cast< std::uint64_t >( _ray ) >> 32 ), _renderingPass, _iteration }, key ) };
+            const auto energy{ cumulatedEnergies.back() };
+            const auto itPhoton{ std::upper_bound( cumulatedEnergies.begin(), cumulatedEnergies.end(), Philox::Uniform( random[ 0 ] ) * energy ) };
+            const auto & photon{ _photons[ static_cast< std::size_t >( itPhoton - cumulatedEnergies.begin() ) ] };
+            const auto rayWeight{ energy / ( Energy( photon.color ) * static_cast< Real >( rayCount ) ) }; // 1 / (ray count * photon probability)
+            const auto photonPosition{ VecCast< T >( photon.position ) };
+
+            // uniform texel of a uniform plate, the very same terms as the exhaustive kernel:
+            if( _options.raySampling == RaySampling::plates ) {
+                const auto plateIndex{ std::min( static_cast< std::size_t >( Philox::Uniform( random[ 1 ] ) * static_cast< Real >( _plates.size() ) ), _plates.size() - 1 ) };
+                const auto texel{ std::min( static_cast< unsigned >( Philox::Uniform( random[ 2 ] ) * texelCount ), texelCount - 1 ) };
+                const auto & plateTexels{ texels[ plateIndex ] };
+                const auto position{ VecArrayGet( plateTexels.positions, texel ) };
+                const auto rayNormal{ VecNorm( VecSub( photonPosition, position ) ) };
+                if( !VecFacing( rayNormal, photon.normal ) ) {
+                    ++pThreadCounters->facingRejections;
+                    return { noPlate, 0, {} };
+                }
+                if( ( *transport.pOcclusion )( GeometryTexelPosition< T, TextureWidth >( transport, plateTexels, plateIndex, texel ), photon.position, plateIndex ) )
+                    return { noPlate, 0, {} };
+                const auto wavelengthDecay{ WavelengthDecay( transport.wavelengthDecay, DistanceFactor( transport.wavelengthDecayDistance, VecDist( photonPosition, position ) ) ) };
+                const auto raySrcAngle{ -VecDot( photon.normal, rayNormal ) };
+                const auto weight{ static_cast< T >( rayWeight * static_cast< Real >( _plates.size() ) * texelCount ) };
+                const auto received{ VecMult( VecMult( VecMult( photon.color, VecCast< T >( _plates[ plateIndex ].material.color ) ), wavelengthDecay ), raySrcAngle * weight ) };
+                return { static_cast< unsigned >( plateIndex ), texel, received };
+            }
+
+            // cosine-weighted direction around the photon normal, up to the nearest plate:
+            const auto normal{ VecCast< Real >( photon.normal ) };
+            const auto tangent{ VecNorm( VecCross( normal, std::abs( normal[ 0 ] ) > Real{ 0.9 } ? Vector3D{ 0, 1, 0 } : Vector3D{ 1, 0, 0 } ) ) };
+            const auto bitangent{ VecCross( normal, tangent ) };
+            const auto radius{ std::sqrt( Philox::Uniform( random[ 1 ] ) ) };
+            const auto angle{ 2 * std::numbers::pi * Philox::Uniform( random[ 2 ] ) };
+            const auto direction{ VecAdd( VecAdd( VecMult( tangent, radius * std::cos( angle ) ), VecMult( bitangent, radius * std::sin( angle ) ) ),
+                VecMult( normal, std::sqrt( std::max( 1 - radius * radius, Real{ 0 } ) ) ) ) };
+            const auto length{ VecDist( photon.position, sceneCenter ) + sceneRadius };
+            std::uint64_t triangleCount{ 0 };
+            const auto hit{ SegmentNearestPlate( nearestTree, nearestQuads, photon.position, VecAdd( photon.position, VecMult( direction, length ) ), triangleCount ) };
+            ++pThreadCounters->occlusionTests;
+            pThreadCounters->trianglesTested += triangleCount;
+            if( !hit )
+                return { noPlate, 0, {} }; // left the scene
+            const auto & [ plateIndex, t ]{ *hit };
+            const auto & plate{ _plates[ plateIndex ] };
+            const auto distance{ length * t };
+            const auto offset{ VecSub( VecAdd( photon.position, VecMult( direction, distance ) ), plate.positions[ 0 ] ) };
+            const auto TexelCoordinate{ [ & ]( const Vector3D & _axis ) {
+                    return std::min( static_cast< unsigned >( std::max( VecDot( offset, _axis ) / VecDot( _axis, _axis ), Real{ 0 } ) * width ), width - 1 );
+                } };
+            const auto texel{ TexelCoordinate( VecSub( plate.positions[ 3 ], plate.positions[ 0 ] ) ) * width + TexelCoordinate( VecSub( plate.positions[ 1 ], plate.positions[ 0 ] ) ) };
+
+            // the source angle cancels out with the sampling density, the texel solid angle being the area times the receiver angle over the squared distance:
+            const auto receiverAngle{ std::max( std::abs( VecDot( plate.normal, direction ) ), minReceiverAngle ) };
+            const auto weight{ static_cast< T >( rayWeight * std::numbers::pi * distance * distance / ( texelAreas[ plateIndex ] * receiverAngle ) ) };
+            const auto wavelengthDecay{ WavelengthDecay( transport.wavelengthDecay, DistanceFactor( transport.wavelengthDecayDistance, static_cast< T >( distance ) ) ) };
+            const auto received{ VecMult( VecMult( VecMult( photon.color, VecCast< T >( plate.material.color ) ), wavelengthDecay ), weight ) };
+            return { static_cast< unsigned >( plateIndex ), texel, received };
+        } };
+
+    const auto iterationCount{ std::max( _options.monteCarloIterations, 1u ) };
+    if( _options.verbose )
+        std::cout << "monte carlo transport: " << rayCount << " ray(s) per pass, " << ( _options.raySampling == RaySampling::plates ? "plate" : "cosine" )
+                  << " sampling, up to " << iterationCount << " iteration(s)" << std::endl;
+    const auto tStart{ std::chrono::high_resolution_clock::now() };
+    const auto Elapsed{ [ & ]{ return std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tStart ).count(); } };
+    unsigned iteration{ 0 };
+    while( iteration < iterationCount ) {
+        if( iteration != 0 && _options.monteCarloSeconds && Elapsed() >= *_options.monteCarloSeconds )
+            break; // the lightmaps are the average of the iterations completed so far
+        ++iteration;
+        ScopedTimer iterationTimer{ _options.pTrace, "iteration " + std::to_string( iteration ) };
+        auto photons{ LightPhotons< T >( _scene, _lightSources ) };
+        VecArrayReset( atlas.emitters, atlas.offsets.back() ); // left over by the last pass of the previous iteration
+        std::uint64_t hitCount{ 0 };
+        unsigned renderingPass{ 0 };
+        while( !photons.empty() && renderingPass < _maxRenderingPass ) {
+            ++renderingPass;
+            ScopedTimer passTimer{ _options.pTrace, "pass " + std::to_string( renderingPass ) };
+
+            // photons picked by inverting their cumulated energies:
+            cumulatedEnergies.clear();
+            Real energy{ 0 };
+            for( const auto & photon : photons )
+                cumulatedEnergies.emplace_back( energy += Energy( photon.color ) );
+            if( !( energy > 0 ) )
+                break;
+            pool.Run( ( rayCount + raysPerTask - 1 ) / raysPerTask, [ & ]( const std::size_t _task ) {
+                for( auto ray{ _task * raysPerTask }; ray < std::min( ( _task + 1 ) * raysPerTask, rayCount ); ++ray )
+                    deposits[ ray ] = Shoot( photons, renderingPass, iteration, ray );
+            } );
+
+            // deposits sorted by plate, in ray order, then summed plate by plate:
+            std::fill( plateFirstDeposits.begin(), plateFirstDeposits.end(), 0 );
+            for( const auto & deposit : deposits )
+                if( deposit.plate != noPlate )
+                    ++plateFirstDeposits[ deposit.plate + 1 ];
+            std::partial_sum( plateFirstDeposits.begin(), plateFirstDeposits.end(), plateFirstDeposits.begin() );
+            depositOrder.resize( plateFirstDeposits.back() );
+            auto plateNextDeposits{ plateFirstDeposits };
+            for( std::size_t ray{ 0 }; ray < rayCount; ++ray )
+                if( deposits[ ray ].plate != noPlate )
+                    depositOrder[ plateNextDeposits[ deposits[ ray ].plate ]++ ] = ray;
+            pool.Run( _plates.size(), [ & ]( const std::size_t _plateIndex ) {
+                auto & plateTexels{ texels[ _plateIndex ] };
+                const auto retransmission{ static_cast< T >( _plates[ _plateIndex ].material.retransmission ) };
+                for( auto i{ plateFirstDeposits[ _plateIndex ] }; i < plateFirstDeposits[ _plateIndex + 1 ]; ++i ) {
+                    const auto & deposit{ deposits[ depositOrder[ i ] ] };
+                    VecArraySet( plateTexels.receivers, deposit.texel, VecAdd( VecArrayGet( plateTexels.receivers, deposit.texel ), deposit.received ) );
+                    VecArraySet( plateTexels.emitters, deposit.texel, VecAdd( VecArrayGet( plateTexels.emitters, deposit.texel ), VecMult( deposit.received, retransmission ) ) ); // cumulated energy transmission
+                }
+                compaction.Count( _plateIndex );
+
+                // the tile published to the viewer averages the iterations so far, the current one included:
+                if( _options.pPreview != nullptr ) {
+                    const auto scale{ realMultiplier * iteration };
+                    _options.pPreview->Publish( _plateIndex, plateTexels.width, [ & ]( const std::size_t _texel ) {
+                            const auto receiver{ VecCast< Real >( VecArrayGet( plateTexels.receivers, _texel ) ) };
+                            return Vector3D{ receiver[ 0 ] / scale, receiver[ 1 ] / scale, receiver[ 2 ] / scale };
+                        } );
+                }
+            } );
+            hitCount += depositOrder.size();
+
+            // convert emitters to photons:
+            auto counters{ pool.TakeCounters() };
+            counters.photonsCulled = EmittersToPhotons( compaction, photons, nextPhotons, photonIndices, pool );
+            counters.photonsEmitted = photons.size();
+            passTimer.args = { { "facingRejections", static_cast< double >( counters.facingRejections ) }, { "occlusionTests", static_cast< double >( counters.occlusionTests ) },
+                { "trianglesTested", static_cast< double >( counters.trianglesTested ) }, { "raysBlocked", static_cast< double >( counters.raysBlocked ) },
+                { "photonsEmitted", static_cast< double >( counters.photonsEmitted ) }, { "photonsCulled", static_cast< double >( counters.photonsCulled ) } };
+        }
+        if( _options.verbose )
+            std::cout << "iteration " << iteration << ": " << renderingPass << " pass(es), " << hitCount << " deposit(s), " << Elapsed() << "s" << std::endl;
+    }
+
+    // average of the iterations, scaled back:
+    const auto scale{ realMultiplier * iteration };
+    Lightmaps lightmaps{ atlas.offsets };
+    for( std::size_t texel{ 0 }; texel < atlas.offsets.back(); ++texel ) {
+        const auto receiver{ VecCast< Real >( VecArrayGet( atlas.receivers, texel ) ) };
+        VecArraySet( lightmaps.texels, texel, { receiver[ 0 ] / scale, receiver[ 1 ] / scale, receiver[ 2 ] / scale } );
+    }
+    return lightmaps;
+}
+
+// incremental relighting state: the plates as far as the transport goes, the texel visibility cache and the lightmap of every
+// light source on its own, the transport being linear in the light source energies:
+inline static constexpr std::array< char, 8 > relightMagic{ 'L', 'S', 'H', 'O', 'T', 'R', 'L', 'T' };
+inline static constexpr std::uint32_t relightVersion{ 1 };
+
+struct RelightHeader
+{
+    std::array< char, 8 > magic;
+    std::uint32_t version;
+    std::uint32_t realSize; // engine precision
+    std::uint64_t termsHash; // transport terms, plates and light sources apart
+    std::uint32_t renderingPassCount;
+    std::uint32_t plateCount;
+    std::uint64_t texelCount; // per plate
+    std::uint32_t lightSourceCount;
+    std::uint64_t entryCount; // visibility cache
+};
+
+struct RelightPlate
+{
+    std::array< Vector3D, 4 > positions;
+    Vector3D normal;
+    Material material;
+};
+
+template< typename T >
+struct RelightState
+{
+    std::vector< RelightPlate > plates;
+    VisibilityCache< T > visibilityCache;
+    std::vector< Photon< Real > > lightSources;
+    std::vector< Lightmaps > lightmaps; // per light source
+};
+
+// streamed section by section, to a temporary file renamed once complete:
+template< typename T >
+bool WriteRelightState( const char * _path, const RelightHeader & _header, const RelightState< T > & _state )
+{
+    static_assert( std::is_trivially_copyable_v< RelightPlate > && std::is_trivially_copyable_v< typename VisibilityCache< T >::Entry > );
+    const std::string temporaryPath{ std::string{ _path } + ".tmp" };
+    {
+        std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+        const auto Write{ [ & ]( const auto * _pData, const std::size_t _count ) {
+                file.write( reinterpret_cast< const char * >( _pData ), static_cast< std::streamsize >( _count * sizeof( *_pData ) ) );
+            } };
+        Write( &_header, 1 );
+        Write( _state.plates.data(), _state.plates.size() );
+        for( const auto & entries : _state.visibilityCache.plates ) {
+            const std::uint64_t entryCount{ entries.size() };
+            Write( &entryCount, 1 );
+            Write( entries.data(), entries.size() );
+        }
+        Write( _state.lightSources.data(), _state.lightSources.size() );
+        for( const auto & lightmaps : _state.lightmaps ) {
+            for( std::size_t plateIndex{ 0 }; plateIndex < lightmaps.size(); ++plateIndex ) {
+                const auto lightmap{ lightmaps[ plateIndex ] };
+                Write( lightmap.x.data(), _header.texelCount );
+                Write( lightmap.y.data(), _header.texelCount );
+                Write( lightmap.z.data(), _header.texelCount );
+            }
+        }
+        file.close();
+        if( !file )
+            return false;
+    }
+    std::error_code error;
+    std::filesystem::rename( temporaryPath, _path, error );
+    return !error;
+}
+
+// nothing when the file is missing or was computed with other transport terms:
+template< typename T >
+std::optional< RelightState< T > > ReadRelightState( const char * _path, const std::uint64_t _termsHash, const unsigned _renderingPassCount, const std::size_t _texelCount )
+{
+    std::ifstream file{ _path, std::ios::binary };
+    const auto Read{ [ & ]( auto * _pData, const std::size_t _count ) {
+            file.read( reinterpret_cast< char * >( _pData ), static_cast< std::streamsize >( _count * sizeof( *_pData ) ) );
+        } };
+    RelightHeader header;
+    Read( &header, 1 );
+    if( !file || header.magic != relightMagic || header.version != relightVersion || header.realSize != sizeof( T ) || header.termsHash != _termsHash
+        || header.renderingPassCount != _renderingPassCount || header.texelCount != _texelCount )
+        return std::nullopt;
+    RelightState< T > state{ std::vector< RelightPlate >( header.plateCount ),
+        VisibilityCache< T >{ std::vector< std::vector< typename VisibilityCache< T >::Entry > >( header.plateCount ), header.entryCount },
+        std::vector< Photon< Real > >( header.lightSourceCount ), std::vector< Lightmaps >( header.lightSourceCount, Lightmaps( header.plateCount, _texelCount ) ) };
+    Read( state.plates.data(), state.plates.size() );
+    for( auto & entries : state.visibilityCache.plates ) {
+        std::uint64_t entryCount{ 0 };
+        Read( &entryCount, 1 );
+        if( !file || entryCount > header.entryCount )
+            return std::nullopt;
+        entries.resize( entryCount );
+        Read( entries.data(), entries.size() );
+    }
+    Read( state.lightSources.data(), state.lightSources.size() );
+    for( auto & lightmaps : state.lightmaps ) {
+        for( std::size_t plateIndex{ 0 }; plateIndex < lightmaps.size(); ++plateIndex ) {
+            const auto lightmap{ lightmaps[ plateIndex ] };
+            Read( lightmap.x.data(), _texelCount );
+            Read( lightmap.y.data(), _texelCount );
+            Read( lightmap.z.data(), _texelCount );
+        }
+    }
+    if( !file )
+        return std::nullopt;
+    return state;
+}
+
+// exact transport solved light source by light source against the previous state: a light source at the same place over the same plates
+// is rescaled to its new color, the other ones are solved again, the visibility cache being traced again only for the (receiving plate,
+// source plate) pairs whose bounds meet a plate which appeared or disappeared, since only those may have gained or lost an occluder:
+template< typename T, unsigned TextureWidth >
+Lightmaps SolveIncremental( const Scene & _scene, const Plates & _plates, const Occlusion & _occlusion, const std::vector< Photon< Real > > & _lightSources,
+    const unsigned _maxRenderingPass, const Options & _options )
+{
+    using Entry = typename VisibilityCache< T >::Entry;
+    const auto transport{ MakeTransport< T >( _scene, _plates, &_occlusion ) };
+    const auto width{ SpecializedWidth< TextureWidth >( _scene.textureWidth ) };
+    const auto texelCount{ width * width };
+    const auto atlas{ PrepareTexels< T, TextureWidth >( _scene, _plates ) };
+    if( _options.cacheBudget == 0 ) {
+        if( _options.verbose )
+            std::cout << "visibility cache disabled, incremental relighting disabled" << std::endl;
+        return Solve< T, TextureWidth >( _scene, _plates, _occlusion, _lightSources, _maxRenderingPass, _options );
+    }
+    const auto termsHash{ SceneHash( _scene, {}, {}, std::nullopt, std::nullopt, 0 ) };
+    auto previous{ ReadRelightState< T >( _options.pRelightPath, termsHash, _maxRenderingPass, texelCount ) };
+    if( !previous && _options.verbose )
+        std::cout << "no relighting state matching these transport terms in " << _options.pRelightPath << ", solving everything" << std::endl;
+
+    // previous index of the plates whose geometry did not change, bounds of the plates which appeared or disappeared:
+    static constexpr std::size_t noPlate{ std::numeric_limits< std::size_t >::max() };
+    std::vector< std::size_t > previousPlates( _plates.size(), noPlate );
+    std::vector< Bounds > changedBounds;
+    bool samePlates{ previous.has_value() && previous->plates.size() == _plates.size() };
+    if( previous ) {
+        std::map< std::pair< std::array< Vector3D, 4 >, Vector3D >, std::size_t > previousIndices;
+        for( std::size_t plateIndex{ 0 }; plateIndex < previous->plates.size(); ++plateIndex )
+            previousIndices.emplace( std::make_pair( previous->plates[ plateIndex ].positions, previous->plates[ plateIndex ].normal ), plateIndex );
+        for( std::size_t plateIndex{ 0 }; plateIndex < _plates.size(); ++plateIndex ) {
+            const auto & plate{ _plates[ plateIndex ] };
+            const auto itPrevious{ previousIndices.find( std::make_pair( plate.positions, plate.normal ) ) };
+            if( itPrevious == previousIndices.end() ) {
+                changedBounds.emplace_back( PlateBounds( plate ) );
+                samePlates = false;
+                continue;
+            }
+            const auto & material{ previous->plates[ itPrevious->second ].material };
+            samePlates = samePlates && material.color == plate.material.color && material.retransmission == plate.material.retransmission;
+            previousPlates[ plateIndex ] = itPrevious->second;
+            previousIndices.erase( itPrevious ); // matched once
+        }
+        for( const auto & previousIndex : previousIndices )
+            changedBounds.emplace_back( PlateBounds( previous->plates[ previousIndex.second ].positions ) );
+    }
+
+    // texel visibility cache, pair by pair, the previous entries of a clean pair being a contiguous range as they are sorted by source:
+    TaskPool pool{ _options.threadCount };
+    std::vector< Bounds > plateBounds;
+    for( const auto & plate : _plates )
+        plateBounds.emplace_back( PlateBounds( plate ) );
+    std::atomic< std::size_t > entryCount{ 0 };
+    std::atomic< std::size_t > redoneCount{ 0 };
+    const auto maxEntryCount{ _options.cacheBudget * 1024 * 1024 / sizeof( Entry ) };
+    std::vector< std::vector< Entry > > pairEntries( _plates.size() * _plates.size() );
+    const auto tCache{ std::chrono::high_resolution_clock::now() };
+    std::optional< PlateVisibilitySet > plateVisibility;
+    if( _options.plateCulling && _plates.size() <= maxVisibilityPlates )
+        plateVisibility = BuildPlateVisibility< T >( _plates, _occlusion, { 0, _plates.size() }, pool );
+    pool.Run( pairEntries.size(), [ & ]( const std::size_t _task ) {
+        if( entryCount.load( std::memory_order_relaxed ) > maxEntryCount )
+            return;
+        const auto plateIndex{ _task / _plates.size() };
+        const auto sourcePlate{ _task % _plates.size() };
+        const auto previousPlate{ previousPlates[ plateIndex ] };
+        const auto previousSource{ previousPlates[ sourcePlate ] };
+        const auto pairBounds{ BoundsUnion( plateBounds[ plateIndex ], plateBounds[ sourcePlate ] ) };
+        auto & entries{ pairEntries[ _task ] };
+        if( previousPlate == noPlate || previousSource == noPlate
+            || std::any_of( changedBounds.begin(), changedBounds.end(), [ & ]( const Bounds & _bounds ) { return BoundsOverlap( pairBounds, _bounds ); } ) ) {
+            TracePlatePair< T, TextureWidth >( transport, atlas.plates, plateIndex, sourcePlate, plateVisibility ? &*plateVisibility : nullptr, entries );
+            ++redoneCount;
+        }
+        else {
+            const auto & previousEntries{ previous->visibilityCache.plates[ previousPlate ] };
+            const auto firstSource{ static_cast< unsigned >( previousSource * texelCount ) };
+            const auto BySource{ []( const Entry & _entry, const unsigned _source ) { return _entry.source < _source; } };
+            const auto itFirst{ std::lower_bound( previousEntries.begin(), previousEntries.end(), firstSource, BySource ) };
+            const auto itLast{ std::lower_bound( itFirst, previousEntries.end(), firstSource + texelCount, BySource ) };
+            entries.assign( itFirst, itLast );
+            for( auto & entry : entries )
+                entry.source = static_cast< unsigned >( sourcePlate * texelCount + entry.source - firstSource );
+        }
+        entryCount += entries.size();
+    } );
+    if( previous )
+        previous->visibilityCache = {};
+    if( entryCount > maxEntryCount ) {
+        if( _options.verbose )
+            std::cout << "visibility cache exceeds " << _options.cacheBudget << "MB budget, incremental relighting disabled" << std::endl;
+        return Solve< T, TextureWidth >( _scene, _plates, _occlusion, _lightSources, _maxRenderingPass, _options );
+    }
+    auto visibilityCache{ GatherVisibilityCache< T >( pairEntries, _plates.size(), { 0, _plates.size() }, pool ) };
+    const auto cacheDuration{ std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::high_resolution_clock::now() - tCache ) };
+
+    // every light source on its own, exact transport on the cache, no checkpoint:
+    Options lightSourceOptions{ _options };
+    lightSourceOptions.hierarchicalThreshold.reset();
+    lightSourceOptions.pCheckpointPath = nullptr;
+    lightSourceOptions.resume = false;
+    lightSourceOptions.morePasses.reset();
+    lightSourceOptions.pPreview = nullptr; // the sum over the light sources only is shown
+    const auto PreviousLightSource{ [ & ]( const Photon< Real > & _lightSource ) -> std::optional< std::size_t > {
+            if( !samePlates )
+                return std::nullopt;
+            for( std::size_t lightIndex{ 0 }; lightIndex < previous->lightSources.size(); ++lightIndex ) {
+                const auto & previousLightSource{ previous->lightSources[ lightIndex ] };
+                const auto & color{ previousLightSource.color };
+                if( previousLightSource.position == _lightSource.position && previousLightSource.normal == _lightSource.normal && color[ 0 ] > 0 && color[ 1 ] > 0 && color[ 2 ] > 0 )
+                    return lightIndex;
+            }
+            return std::nullopt;
+        } };
+    RelightState< T > state;
+    unsigned rescaledCount{ 0 };
+    for( const auto & lightSource : _lightSources ) {
+        const auto previousLightSource{ PreviousLightSource( lightSource ) };
+        if( !previousLightSource ) {
+            state.lightmaps.emplace_back( Solve< T, TextureWidth >( _scene, _plates, _occlusion, { lightSource }, _maxRenderingPass, lightSourceOptions, &visibilityCache ) );
+            continue;
+        }
+        const auto & previousColor{ previous->lightSources[ *previousLightSource ].color };
+        const Vector3D scale{ lightSource.color[ 0 ] / previousColor[ 0 ], lightSource.color[ 1 ] / previousColor[ 1 ], lightSource.color[ 2 ] / previousColor[ 2 ] };
+        auto & lightmaps{ state.lightmaps.emplace_back( Lightmaps( _plates.size(), texelCount ) ) };
+        for( std::size_t plateIndex{ 0 }; plateIndex < _plates.size(); ++plateIndex ) {
+            const auto previousLightmap{ previous->lightmaps[ *previousLightSource ][ previousPlates[ plateIndex ] ] };
+            const auto lightmap{ lightmaps[ plateIndex ] };
+            for( std::size_t texel{ 0 }; texel < texelCount; ++texel )
+                VecArraySet( lightmap, texel, VecMult( VecArrayGet( previousLightmap, texel ), scale ) );
+        }
+        ++rescaledCount;
+    }
+
+    // the lightmaps add up:
+    Lightmaps lightmaps( _plates.size(), texelCount );
+    for( const auto & lightSourceLightmaps : state.lightmaps )
+        for( std::size_t texel{ 0 }; texel < lightmaps.offsets.back(); ++texel )
+            VecArraySet( lightmaps.texels, texel, VecAdd( VecArrayGet( lightmaps.texels, texel ), VecArrayGet( lightSourceLightmaps.texels, texel ) ) );
+
+    if( _options.verbose ) {
+        std::cout << "plate pair(s): " << redoneCount << " traced again, " << pairEntries.size() - redoneCount << " reused, visibility cache ready in " << cacheDuration.count() << "ms" << std::endl;
+        std::cout << "light source(s): " << rescaledCount << " rescaled, " << _lightSources.size() - rescaledCount << " solved" << std::endl;
+    }
+
+    for( const auto & plate : _plates )
+        state.plates.emplace_back( RelightPlate{ plate.positions, plate.normal, plate.material } );
+    state.visibilityCache = std::move( visibilityCache );
+    state.lightSources = _lightSources;
+    const RelightHeader header{ relightMagic, relightVersion, sizeof( T ), termsHash, _maxRenderingPass, static_cast< std::uint32_t >( _plates.size() ),
+        texelCount, static_cast< std::uint32_t >( _lightSources.size() ), state.visibilityCache.entryCount };
+    if( !WriteRelightState( _options.pRelightPath, header, state ) )
+        std::cerr << "Failed to write relighting state " << _options.pRelightPath << std::endl;
+    return lightmaps;
+}
+
+// texture width of every plate from a solve at the base width: a plate is subdivided once per doubling of its largest step between
+// neighbouring texels over the threshold, the received energies being clamped to the displayed range, up to the given level count:
+std::vector< unsigned > AdaptiveWidths( const Lightmaps & _lightmaps, const unsigned _baseWidth, const Real _threshold, const unsigned _maxLevel )
+{
+    std::vector< unsigned > widths( _lightmaps.size(), _baseWidth );
+    for( std::size_t plateIndex{ 0 }; plateIndex < _lightmaps.size(); ++plateIndex ) {
+        const auto lightmap{ _lightmaps[ plateIndex ] };
+        const auto Level{ [ & ]( const std::size_t _texel, const std::size_t _channel ) { return std::clamp< Real >( VecArrayGet( lightmap, _texel )[ _channel ], 0, 1 ); } };
+        Real maxStep{ 0 };
+        for( unsigned y{ 0 }; y < _baseWidth; ++y )
+            for( unsigned x{ 0 }; x < _baseWidth; ++x )
+                for( std::size_t channel{ 0 }; channel < 3; ++channel ) {
+                    const auto texel{ std::size_t{ y } * _baseWidth + x };
+                    if( x + 1 < _baseWidth )
+                        maxStep = std::max( maxStep, std::abs( Level( texel + 1, channel ) - Level( texel, channel ) ) );
+                    if( y + 1 < _baseWidth )
+                        maxStep = std::max( maxStep, std::abs( Level( texel + _baseWidth, channel ) - Level( texel, channel ) ) );
+                }
+        const auto level{ maxStep <= _threshold ? 0u : std::min( _maxLevel, static_cast< unsigned >( std::ceil( std::log2( maxStep / _threshold ) ) ) ) };
+        widths[ plateIndex ] = _baseWidth << level;
+    }
+    return widths;
+}
+
+// adaptive resolution: a solve at the scene texture width finds the plates whose lightmaps change fast, then the generic engine solves
+// every plate at its own width, the light sources being sampled at the finest width as a uniform solve at that width samples them:
+template< typename T, unsigned TextureWidth >
+Lightmaps SolveAdaptive( const Scene & _scene, const Plates & _plates, const Occlusion & _occlusion, const std::vector< Photon< Real > > & _lightSources,
+    const unsigned _maxRenderingPass, const Options & _options, const Real _threshold, const unsigned _maxLevel )
+{
+    const auto tCoarse{ std::chrono::high_resolution_clock::now() };
+    const auto coarse{ Solve< T, TextureWidth >( _scene, _plates, _occlusion, _lightSources, _maxRenderingPass, _options ) };
+    const auto coarseDuration{ std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tCoarse ).count() };
+
+    const auto widths{ AdaptiveWidths( coarse, _scene.textureWidth, _threshold, _maxLevel ) };
+    std::vector< std::size_t > levelCounts( _maxLevel + 1, 0 );
+    std::size_t texelTotal{ 0 };
+    for( const auto width : widths ) {
+        ++levelCounts[ static_cast< std::size_t >( std::log2( width / _scene.textureWidth ) ) ];
+        texelTotal += std::size_t{ width } * width;
+    }
+    Scene fineScene{ _scene };
+    fineScene.textureWidth = _scene.textureWidth << _maxLevel;
+    const auto uniformTotal{ _plates.size() * fineScene.textureWidth * fineScene.textureWidth };
+    std::cout << "adaptive resolution:";
+    for( unsigned level{ 0 }; level <= _maxLevel; ++level )
+        std::cout << ( level == 0 ? " " : ", " ) << levelCounts[ level ] << " plate(s) at " << ( _scene.textureWidth << level ) << "x" << ( _scene.textureWidth << level );
+    std::cout << ", " << texelTotal << " texel(s) (" << static_cast< double >( texelTotal ) * 100 / static_cast< double >( uniformTotal ) << "% of "
+              << fineScene.textureWidth << "x" << fineScene.textureWidth << ")" << std::endl;
+
+    Options fineOptions{ _options };
+    fineOptions.pPlateWidths = &widths;
+    const auto tFine{ std::chrono::high_resolution_clock::now() };
+    auto lightmaps{ Solve< T, 0 >( fineScene, _plates, _occlusion, _lightSources, _maxRenderingPass, fineOptions ) };
+    const auto fineDuration{ std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tFine ).count() };
+    std::cout << "adaptive duration: " << coarseDuration << "s base solve, " << fineDuration << "s adaptive solve" << std::endl;
+    return lightmaps;
+}
+
+// binary lightmap file, versioned, every section starting on a page boundary so that a mapped file is used in place:
+inline static constexpr std::array< char, 8 > lightmapFileMagic{ 'L', 'S', 'H', 'O', 'T', 'M', 'A', 'P' };
+inline static constexpr std::uint32_t lightmapFileVersion{ 3 };
+inline static constexpr std::uint64_t lightmapFilePageSize{ 4096 };
+
+struct LightmapFileHeader
+{
+    std::array< char, 8 > magic;
+    std::uint32_t version;
+    std::uint32_t plateCount;
+    std::uint32_t textureWidth; // of the atlas tiles, the plates of other widths being resampled into them
+    std::uint32_t sceneWidth; // in plates
+    std::uint32_t sceneHeight; // in plates
+    float plateWidth;
+    std::uint32_t atlasWidth; // in texels
+    std::uint32_t atlasHeight;
+    std::uint64_t positionsOffset; // float[ plate ][ 4 ][ 3 ]
+    std::uint64_t texturesOffset; // float[ plate ][ 4 ][ 2 ], in the atlas
+    std::uint64_t normalsOffset; // float[ plate ][ 3 ]
+    std::uint64_t widthsOffset; // uint32_t[ plate ], texture width of every plate
+    std::uint64_t receiversOffset; // float[ texel ][ 3 ], received energies, plate after plate, a plate having the square of its width
+    std::uint64_t colorsOffset; // unsigned char[ atlas height ][ atlas width ][ 3 ], 8-bit texture colors of the plate tiles
+    std::uint64_t fileSize;
+};
+
+inline static std::uint64_t PageAlign( const std::uint64_t _size )
+{
+    return ( _size + lightmapFilePageSize - 1 ) / lightmapFilePageSize * lightmapFilePageSize;
+}
+
+LightmapFileHeader LightmapFileLayout( const Scene & _scene, const unsigned _tileWidth, const AtlasOffsets & _offsets )
+{
+    const auto plateCount{ _offsets.size() - 1 };
+    const auto atlas{ MakeTextureAtlas( plateCount, _tileWidth ) };
+    LightmapFileHeader header{};
+    header.magic = lightmapFileMagic;
+    header.version = lightmapFileVersion;
+    header.plateCount = static_cast< std::uint32_t >( plateCount );
+    header.textureWidth = _tileWidth;
+    header.sceneWidth = _scene.width;
+    header.sceneHeight = _scene.height;
+    header.plateWidth = static_cast< float >( _scene.plateWidth );
+    header.atlasWidth = atlas.width;
+    header.atlasHeight = atlas.height;
+    header.positionsOffset = PageAlign( sizeof( LightmapFileHeader ) );
+    header.texturesOffset = PageAlign( header.positionsOffset + plateCount * 4 * 3 * sizeof( float ) );
+    header.normalsOffset = PageAlign( header.texturesOffset + plateCount * 4 * 2 * sizeof( float ) );
+    header.widthsOffset = PageAlign( header.normalsOffset + plateCount * 3 * sizeof( float ) );
+    header.receiversOffset = PageAlign( header.widthsOffset + plateCount * sizeof( std::uint32_t ) );
+    header.colorsOffset = PageAlign( header.receiversOffset + _offsets.back() * 3 * sizeof( float ) );
+    header.fileSize = PageAlign( header.colorsOffset + std::uint64_t{ atlas.width } * atlas.height * 3 );
+    return header;
+}
+
+// fills an image of LightmapFileLayout size, the atlas colors being already converted:
+void WriteLightmapImage( std::byte * _pImage, const LightmapFileHeader & _header, const Plates & _plates, const Lightmaps & _lightmaps, const std::vector< Color > & _colors )
+{
+    std::memset( _pImage, 0, _header.fileSize );
+    std::memcpy( _pImage, &_header, sizeof( LightmapFileHeader ) );
+    auto * const positions{ reinterpret_cast< float * >( _pImage + _header.positionsOffset ) };
+    auto * const textures{ reinterpret_cast< float * >( _pImage + _header.texturesOffset ) };
+    auto * const normals{ reinterpret_cast< float * >( _pImage + _header.normalsOffset ) };
+    auto * const widths{ reinterpret_cast< std::uint32_t * >( _pImage + _header.widthsOffset ) };
+    auto * const receivers{ reinterpret_cast< float * >( _pImage + _header.receiversOffset ) };
+    const auto atlas{ MakeTextureAtlas( _plates.size(), _header.textureWidth ) };
+    const std::array< Real, 2 > atlasSize{ static_cast< Real >( atlas.width ), static_cast< Real >( atlas.height ) };
+    for( std::size_t plateIndex{ 0 }; plateIndex < _plates.size(); ++plateIndex ) {
+        const auto & plate{ _plates[ plateIndex ] };
+        const auto origin{ atlas.TileOrigin( plateIndex ) };
+        for( std::size_t i{ 0 }; i < 4; ++i ) {
+            for( std::size_t j{ 0 }; j < 3; ++j )
+                positions[ ( plateIndex * 4 + i ) * 3 + j ] = static_cast< float >( plate.positions[ i ][ j ] );
+            for( std::size_t j{ 0 }; j < 2; ++j )
+                textures[ ( plateIndex * 4 + i ) * 2 + j ] = static_cast< float >( ( origin[ j ] + plateTextures[ i ][ j ] * atlas.tileWidth ) / atlasSize[ j ] );
+        }
+        for( std::size_t j{ 0 }; j < 3; ++j )
+            normals[ plateIndex * 3 + j ] = static_cast< float >( plate.normal[ j ] );
+        widths[ plateIndex ] = PlateWidth( _lightmaps.offsets, plateIndex );
+    }
+    for( std::size_t texel{ 0 }; texel < _lightmaps.offsets.back(); ++texel ) {
+        const auto receiver{ VecArrayGet( _lightmaps.texels, texel ) };
+        for( std::size_t j{ 0 }; j < 3; ++j )
+            receivers[ texel * 3 + j ] = static_cast< float >( receiver[ j ] );
+    }
+    static_assert( sizeof( Color ) == 3 );
+    std::memcpy( _pImage + _header.colorsOffset, _colors.data(), _colors.size() * sizeof( Color ) );
+}
+
+// sections of a lightmap image, pointing into it:
+struct LightmapView
+{
+    const LightmapFileHeader * pHeader;
+    const float * positions;
+    const float * textures;
+    const float * normals;
+    const std::uint32_t * widths;
+    const float * receivers;
+    const unsigned char * colors;
+};
+
+// texture widths past this one are taken for corruption, keeping the texel counts and the atlas size far from overflowing:
+inline static constexpr std::uint32_t maxLightmapFileWidth{ 1u << 14 };
+
+// returns nothing when the image is not a lightmap file of this version, is truncated or has sections or an atlas not matching its plates:
+std::optional< LightmapView > ViewLightmapImage( const std::byte * _pImage, const std::size_t _size )
+{
+    if( _size < sizeof( LightmapFileHeader ) )
+        return std::nullopt;
+    const auto * const pHeader{ reinterpret_cast< const LightmapFileHeader * >( _pImage ) };
+    if( pHeader->magic != lightmapFileMagic || pHeader->version != lightmapFileVersion || pHeader->fileSize > _size )
+        return std::nullopt;
+
+    // every section within the file, without overflowing:
+    const auto SectionFits{ [ & ]( const std::uint64_t _offset, const std::uint64_t _count, const std::uint64_t _elementSize ) {
+            return _offset >= sizeof( LightmapFileHeader ) && _offset <= pHeader->fileSize && _count <= ( pHeader->fileSize - _offset ) / _elementSize;
+        } };
+    const std::uint64_t plateCount{ pHeader->plateCount };
+    if( !SectionFits( pHeader->positionsOffset, plateCount * 4 * 3, sizeof( float ) ) || !SectionFits( pHeader->texturesOffset, plateCount * 4 * 2, sizeof( float ) )
+        || !SectionFits( pHeader->normalsOffset, plateCount * 3, sizeof( float ) ) || !SectionFits( pHeader->widthsOffset, plateCount, sizeof( std::uint32_t ) ) )
+        return std::nullopt;
+    const auto * const widths{ reinterpret_cast< const std::uint32_t * >( _pImage + pHeader->widthsOffset ) };
+    std::uint64_t texelCount{ 0 };
+    for( std::uint64_t plateIndex{ 0 }; plateIndex < plateCount; ++plateIndex ) {
+        if( widths[ plateIndex ] == 0 || widths[ plateIndex ] > maxLightmapFileWidth )
+            return std::nullopt;
+        texelCount += std::uint64_t{ widths[ plateIndex ] } * widths[ plateIndex ];
+    }
+    if( !SectionFits( pHeader->receiversOffset, texelCount * 3, sizeof( float ) ) )
+        return std::nullopt;
+
+    // the atlas of the plate tiles, as written:
+    if( pHeader->plateCount == 0 || pHeader->textureWidth == 0 || pHeader->textureWidth > maxLightmapFileWidth )
+        return std::nullopt;
+    const auto atlas{ MakeTextureAtlas( pHeader->plateCount, pHeader->textureWidth ) };
+    if( pHeader->atlasWidth != atlas.width || pHeader->atlasHeight != atlas.height
+        || !SectionFits( pHeader->colorsOffset, std::uint64_t{ pHeader->atlasWidth } * pHeader->atlasHeight, 3 ) )
+        return std::nullopt;
+    return LightmapView{ pHeader, reinterpret_cast< const float * >( _pImage + pHeader->positionsOffset ), reinterpret_cast< const float * >( _pImage + pHeader->texturesOffset ),
+        reinterpret_cast< const float * >( _pImage + pHeader->normalsOffset ), reinterpret_cast< const std::uint32_t * >( _pImage + pHeader->widthsOffset ),
+        reinterpret_cast< const float * >( _pImage + pHeader->receiversOffset ),
+        reinterpret_cast< const unsigned char * >( _pImage + pHeader->colorsOffset ) };
+}
+
+// whole file mapping, read-only once opened unless asked otherwise, read-write once created, unmapped on destruction:
+struct MappedFile
+{
+    std::byte * pData{ nullptr };
+    std::size_t size{ 0 };
+#if defined( _WIN32 )
+    HANDLE file{ INVALID_HANDLE_VALUE };
+    HANDLE mapping{ nullptr };
+#else
+    int file{ -1 };
+#endif
+
+    MappedFile() = default;
+    MappedFile( const MappedFile & ) = delete;
+    MappedFile & operator =( const MappedFile & ) = delete;
+
+    ~MappedFile()
+    {
+#if defined( _WIN32 )
+        if( pData != nullptr )
+            ::UnmapViewOfFile( pData );
+        if( mapping != nullptr )
+            ::CloseHandle( mapping );
+        if( file != INVALID_HANDLE_VALUE )
+            ::CloseHandle( file );
+#else
+        if( pData != nullptr )
+            ::munmap( pData, size );
+        if( file != -1 )
+            ::close( file );
+#endif
+    }
+
+    bool Open( const char * _path, const bool _writable = false )
+    {
+#if defined( _WIN32 )
+        file = ::CreateFileA( _path, _writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ | ( _writable ? FILE_SHARE_WRITE : 0 ), nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr );
+        LARGE_INTEGER fileSize;
+        if( file == INVALID_HANDLE_VALUE || !::GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 )
+            return false;
+        size = static_cast< std::size_t >( fileSize.QuadPart );
+        mapping = ::CreateFileMappingA( file, nullptr, _writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr );
+        if( mapping != nullptr )
+            pData = static_cast< std::byte * >( ::MapViewOfFile( mapping, _writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0 ) );
+#else
+        file = ::open( _path, _writable ? O_RDWR : O_RDONLY );
+        struct stat fileStat;
+        if( file == -1 || ::fstat( file, &fileStat ) != 0 || fileStat.st_size == 0 )
+            return false;
+        size = static_cast< std::size_t >( fileStat.st_size );
+        void * const pMapping{ ::mmap( nullptr, size, _writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0 ) };
+        pData = pMapping == MAP_FAILED ? nullptr : static_cast< std::byte * >( pMapping );
+#endif
+        return pData != nullptr;
+    }
+
+    bool Create( const char * _path, const std::size_t _size )
+    {
+        size = _size;
+#if defined( _WIN32 )
+        file = ::CreateFileA( _path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr );
+        if( file == INVALID_HANDLE_VALUE )
+            return false;
+        mapping = ::CreateFileMappingA( file, nullptr, PAGE_READWRITE, static_cast< DWORD >( std::uint64_t{ _size } >> 32 ), static_cast< DWORD >( _size ), nullptr );
+        if( mapping != nullptr )
+            pData = static_cast< std::byte * >( ::MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, _size ) );
+#else
+        file = ::open( _path, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+        if( file == -1 || ::ftruncate( file, static_cast< off_t >( _size ) ) != 0 )
+            return false;
+        void * const pMapping{ ::mmap( nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0 ) };
+        pData = pMapping == MAP_FAILED ? nullptr : static_cast< std::byte * >( pMapping );
+#endif
+        return pData != nullptr;
+    }
+};
+
+
+// calls the templated function object with the texture width as template argument when the engine is specialized for it:
+template< typename T, typename Function >
+auto DispatchTextureWidth( const unsigned _textureWidth, const Function & _Function )
+{
+    switch( _textureWidth ) {
+        case 8: return _Function.template operator()< T, 8 >();
+        case 16: return _Function.template operator()< T, 16 >();
+        case 32: return _Function.template operator()< T, 32 >();
+        case 64: return _Function.template operator()< T, 64 >();
+        default: return _Function.template operator()< T, 0 >();
+    }
+}
+
+
+// exchange file of the sharded solve: the scene, the plates and the light sources, then the photon and lightmap sections:
+template< typename T >
+ShardHeader ShardLayout( const Scene & _scene, const std::size_t _plateCount, const std::size_t _lightSourceCount, const unsigned _shardCount, const unsigned _maxRenderingPass )
+{
+    static_assert( std::is_trivially_copyable_v< Plate > && std::is_trivially_copyable_v< Photon< T > > );
+    const std::uint64_t texelCount{ std::uint64_t{ _plateCount } * _scene.textureWidth * _scene.textureWidth };
+    ShardHeader header{};
+    header.magic = shardMagic;
+    header.version = shardVersion;
+    header.realSize = sizeof( T );
+    header.shardCount = _shardCount;
+    header.plateCount = static_cast< std::uint32_t >( _plateCount );
+    header.lightSourceCount = static_cast< std::uint32_t >( _lightSourceCount );
+    header.maxRenderingPass = _maxRenderingPass;
+    header.texelCount = texelCount;
+    header.scene = _scene;
+    header.controlOffset = PageAlign( sizeof( ShardHeader ) );
+    header.slotsOffset = PageAlign( header.controlOffset + sizeof( ShardControl ) );
+    header.platesOffset = PageAlign( header.slotsOffset + _shardCount * sizeof( ShardSlot ) );
+    header.lightSourcesOffset = PageAlign( header.platesOffset + _plateCount * sizeof( Plate ) );
+    header.photonsOffset = PageAlign( header.lightSourcesOffset + _lightSourceCount * sizeof( Photon< Real > ) );
+    header.photonIndicesOffset = PageAlign( header.photonsOffset + texelCount * sizeof( Photon< T > ) );
+    header.shardPhotonsOffset = PageAlign( header.photonIndicesOffset + texelCount * sizeof( unsigned ) );
+    header.shardPhotonIndicesOffset = PageAlign( header.shardPhotonsOffset + texelCount * sizeof( Photon< T > ) );
+    header.receiversOffset = PageAlign( header.shardPhotonIndicesOffset + texelCount * sizeof( unsigned ) );
+    header.fileSize = PageAlign( header.receiversOffset + texelCount * 3 * sizeof( Real ) );
+    return header;
+}
+
+inline static std::uint64_t CurrentProcessId()
+{
+#if defined( _WIN32 )
+    return ::GetCurrentProcessId();
+#else
+    return static_cast< std::uint64_t >( ::getpid() );
+#endif
+}
+
+// worker process of the sharded solve, this executable started again with the worker arguments:
+struct ShardProcess
+{
+#if defined( _WIN32 )
+    HANDLE process{ nullptr };
+#else
+    pid_t process{ -1 };
+#endif
+    std::optional< int > exitCode;
+
+    ShardProcess() = default;
+    ShardProcess( const ShardProcess & ) = delete;
+    ShardProcess & operator =( const ShardProcess & ) = delete;
+
+    ~ShardProcess()
+    {
+#if defined( _WIN32 )
+        if( process != nullptr )
+            ::CloseHandle( process );
+#endif
+    }
+
+    bool Start( const std::vector< std::string > & _arguments )
+    {
+#if defined( _WIN32 )
+        char path[ MAX_PATH ];
+        if( ::GetModuleFileNameA( nullptr, path, MAX_PATH ) == 0 )
+            return false;
+        std::string commandLine;
+        for( const auto & argument : _arguments )
+            commandLine += ( commandLine.empty() ? "\"" : " \"" ) + argument + "\"";
+        STARTUPINFOA startupInfo{ sizeof( STARTUPINFOA ) };
+        PROCESS_INFORMATION processInfo{};
+        if( !::CreateProcessA( path, commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo ) )
+            return false;
+        ::CloseHandle( processInfo.hThread );
+        process = processInfo.hProcess;
+        return true;
+#else
+        std::vector< char * > argv;
+        for( const auto & argument : _arguments )
+            argv.push_back( const_cast< char * >( argument.c_str() ) );
+        argv.push_back( nullptr );
+        return ::posix_spawnp( &process, argv.front(), nullptr, nullptr, argv.data(), environ ) == 0;
+#endif
+    }
+
+    // the exit code is kept once the process is gone:
+    bool Running()
+    {
+        if( exitCode )
+            return false;
+#if defined( _WIN32 )
+        if( process == nullptr || ::WaitForSingleObject( process, 0 ) == WAIT_TIMEOUT )
+            return process != nullptr;
+        DWORD code{ 0 };
+        exitCode = ::GetExitCodeProcess( process, &code ) ? static_cast< int >( code ) : -1;
+#else
+        int status{ 0 };
+        const auto result{ process != -1 ? ::waitpid( process, &status, WNOHANG ) : -1 };
+        if( result == 0 )
+            return true;
+        exitCode = result == process && WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+#endif
+        return false;
+    }
+
+    int Wait()
+    {
+#if defined( _WIN32 )
+        if( process != nullptr )
+            ::WaitForSingleObject( process, INFINITE );
+#else
+        if( process != -1 && !exitCode ) {
+            int status{ 0 };
+            exitCode = ::waitpid( process, &status, 0 ) == process && WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+        }
+#endif
+        Running();
+        return exitCode.value_or( -1 );
+    }
+
+    void Kill()
+    {
+        if( !Running() )
+            return;
+#if defined( _WIN32 )
+        ::TerminateProcess( process, 1 );
+#else
+        ::kill( process, SIGKILL );
+#endif
+        Wait();
+    }
+};
+
+// coordinator of the sharded solve: the receiving plates are split evenly among the worker processes, the photons they emit
+// are merged shard after shard every pass, so that the photon list and the lightmaps are those of a single process:
+template< typename T >
+Lightmaps SolveSharded( const Scene & _scene, const Plates & _plates, const std::vector< Photon< Real > > & _lightSources, const unsigned _maxRenderingPass,
+    const Options & _options, const unsigned _shardCount, const std::vector< std::string > & _workerArguments, const char * _pExchangePath )
+{
+    const auto header{ ShardLayout< T >( _scene, _plates.size(), _lightSources.size(), _shardCount, _maxRenderingPass ) };
+    const auto exchangePath{ _pExchangePath != nullptr ? std::filesystem::path{ _pExchangePath }
+                                                       : std::filesystem::temp_directory_path() / ( "lightshot-" + std::to_string( CurrentProcessId() ) + ".shards" ) };
+    const auto Coordinate{ [ & ]() -> Lightmaps {
+            MappedFile file;
+            if( !file.Create( exchangePath.string().c_str(), header.fileSize ) ) {
+                std::cerr << "Failed to create shard exchange file " << exchangePath.string() << std::endl;
+                return {};
+            }
+            std::memcpy( file.pData, &header, sizeof( ShardHeader ) );
+            auto * const pControl{ new( file.pData + header.controlOffset ) ShardControl{} };
+            pControl->coordinator = CurrentProcessId();
+            auto * const pSlots{ reinterpret_cast< ShardSlot * >( file.pData + header.slotsOffset ) };
+            const std::uint64_t plateTexelCount{ std::uint64_t{ _scene.textureWidth } * _scene.textureWidth };
+            for( unsigned shard{ 0 }; shard < _shardCount; ++shard ) {
+                auto * const pSlot{ new( pSlots + shard ) ShardSlot{} };
+                pSlot->firstPlate = _plates.size() * shard / _shardCount;
+                pSlot->lastPlate = _plates.size() * ( shard + 1 ) / _shardCount;
+                pSlot->firstTexel = pSlot->firstPlate * plateTexelCount;
+                pSlot->lastTexel = pSlot->lastPlate * plateTexelCount;
+            }
+            std::copy( _plates.begin(), _plates.end(), reinterpret_cast< Plate * >( file.pData + header.platesOffset ) );
+            std::copy( _lightSources.begin(), _lightSources.end(), reinterpret_cast< Photon< Real > * >( file.pData + header.lightSourcesOffset ) );
+
+            // any failure stops every worker process:
+            std::vector< ShardProcess > processes( _shardCount );
+            const auto Abort{ [ & ]( const char * _pReason ) {
+                    std::cerr << "Sharded solve failed: " << _pReason << std::endl;
+                    pControl->aborted.store( 1, std::memory_order_release );
+                    for( auto & process : processes )
+                        process.Kill();
+                    return Lightmaps{};
+                } };
+            for( unsigned shard{ 0 }; shard < _shardCount; ++shard ) {
+                auto arguments{ _workerArguments };
+                arguments.insert( arguments.end(), { "--shard-worker", exchangePath.string(), std::to_string( shard ) } );
+                if( !processes[ shard ].Start( arguments ) )
+                    return Abort( "cannot start a worker process" );
+            }
+
+            // every shard polled until done, false as soon as a worker process is gone before:
+            const auto WaitShards{ [ & ]( const auto & _Done ) {
+                    for( unsigned shard{ 0 }; shard < _shardCount; ++shard ) {
+                        while( !_Done( pSlots[ shard ] ) ) {
+                            if( !processes[ shard ].Running() && !_Done( pSlots[ shard ] ) )
+                                return false;
+                            std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+                        }
+                    }
+                    return true;
+                } };
+            if( _options.verbose )
+                for( unsigned shard{ 0 }; shard < _shardCount; ++shard )
+                    std::cout << "shard " << shard << ": plates " << pSlots[ shard ].firstPlate << " to " << pSlots[ shard ].lastPlate - 1 << std::endl;
+
+            // the same passes as the workers, the shard photons being concatenated and their indices offset by the photons before them:
+            auto * const pPhotons{ reinterpret_cast< Photon< T > * >( file.pData + header.photonsOffset ) };
+            const auto * const pShardPhotons{ reinterpret_cast< const Photon< T > * >( file.pData + header.shardPhotonsOffset ) };
+            auto * const pPhotonIndices{ reinterpret_cast< unsigned * >( file.pData + header.photonIndicesOffset ) };
+            const auto * const pShardPhotonIndices{ reinterpret_cast< const unsigned * >( file.pData + header.shardPhotonIndicesOffset ) };
+            std::uint64_t photonCount{ _lightSources.size() * plateTexelCount };
+            unsigned renderingPass{ 0 };
+            while( photonCount != 0 && renderingPass < _maxRenderingPass ) {
+                ++renderingPass;
+                ScopedTimer passTimer{ _options.pTrace, "pass " + std::to_string( renderingPass ) };
+                if( _options.verbose )
+                    std::cout << "pass " << renderingPass << "/" << _maxRenderingPass << " - " << photonCount << " photon(s)" << std::endl;
+                const auto tPass{ std::chrono::high_resolution_clock::now() };
+                if( !WaitShards( [ & ]( const ShardSlot & _slot ) { return _slot.donePass.load( std::memory_order_acquire ) >= renderingPass; } ) )
+                    return Abort( "a worker process exited during a pass" );
+                const auto tMerge{ std::chrono::high_resolution_clock::now() };
+                photonCount = 0;
+                for( unsigned shard{ 0 }; shard < _shardCount; ++shard ) {
+                    const auto & slot{ pSlots[ shard ] };
+                    std::copy_n( pShardPhotons + slot.firstTexel, slot.photonCount, pPhotons + photonCount );
+                    for( auto texel{ slot.firstTexel }; texel < slot.lastTexel; ++texel )
+                        pPhotonIndices[ texel ] = pShardPhotonIndices[ texel ] != noPhoton ? pShardPhotonIndices[ texel ] + static_cast< unsigned >( photonCount ) : noPhoton;
+                    photonCount += slot.photonCount;
+                }
+                pControl->photonCount = photonCount;
+                pControl->mergedPass.store( renderingPass, std::memory_order_release );
+                if( _options.verbose )
+                    std::cout << "shards done in " << std::chrono::duration_cast< std::chrono::milliseconds >( tMerge - tPass ).count() << "ms, "
+                              << photonCount << " photon(s) merged in " << std::chrono::duration< double, std::milli >( std::chrono::high_resolution_clock::now() - tMerge ).count() << "ms" << std::endl;
+                passTimer.args = { { "photonsEmitted", static_cast< double >( photonCount ) } };
+            }
+            if( !WaitShards( [ & ]( const ShardSlot & _slot ) { return _slot.finished.load( std::memory_order_acquire ) != 0; } ) )
+                return Abort( "a worker process exited before writing its lightmaps" );
+            for( auto & process : processes )
+                if( process.Wait() != 0 )
+                    return Abort( "a worker process failed" );
+
+            // the receivers of every shard, scaled back by the workers already:
+            Lightmaps lightmaps{ _plates.size(), plateTexelCount };
+            const auto * const pReceivers{ reinterpret_cast< const Real * >( file.pData + header.receiversOffset ) };
+            std::copy_n( pReceivers, header.texelCount, lightmaps.texels.x.begin() );
+            std::copy_n( pReceivers + header.texelCount, header.texelCount, lightmaps.texels.y.begin() );
+            std::copy_n( pReceivers + 2 * header.texelCount, header.texelCount, lightmaps.texels.z.begin() );
+            return lightmaps;
+        } };
+    auto lightmaps{ Coordinate() };
+    std::error_code error;
+    std::filesystem::remove( exchangePath, error );
+    return lightmaps;
+}
+
+// worker process entry: the scene, the plates, the light sources and the precision are read from the exchange file, the other
+// options being those the coordinator was started with:
+int RunShardWorker( const char * _pPath, const unsigned _index, Options _options, const bool _bruteForce, const bool _mergeOccluders )
+{
+    MappedFile file;
+    if( !file.Open( _pPath, true ) || file.size < sizeof( ShardHeader ) ) {
+        std::cerr << "Failed to open shard exchange file " << _pPath << std::endl;
+        return -1;
+    }
+    const auto & header{ *reinterpret_cast< const ShardHeader * >( file.pData ) };
+    if( header.magic != shardMagic || header.version != shardVersion || ( header.realSize != sizeof( float ) && header.realSize != sizeof( double ) )
+        || header.fileSize > file.size || _index >= header.shardCount ) {
+        std::cerr << "Shard exchange file " << _pPath << " does not match this worker" << std::endl;
+        return -1;
+    }
+    const ShardWorker worker{ &header, reinterpret_cast< ShardControl * >( file.pData + header.controlOffset ), reinterpret_cast< ShardSlot * >( file.pData + header.slotsOffset ), _index };
+    const auto * const pPlates{ worker.Section< const Plate >( header.platesOffset ) };
+    const Plates plates( pPlates, pPlates + header.plateCount );
+    const auto * const pLightSources{ worker.Section< const Photon< Real > >( header.lightSourcesOffset ) };
+    const std::vector< Photon< Real > > lightSources( pLightSources, pLightSources + header.lightSourceCount );
+
+    std::vector< unsigned > plateOccluders;
+    const auto occluders{ _mergeOccluders ? MergeOccluders( plates, plateOccluders ) : PlateQuads( plates ) };
+    const auto occlusionTree{ BuildOcclusionTree( occluders ) };
+    const Occlusion occlusion{ occluders, occlusionTree, _bruteForce, _options.kernelIsa == KernelIsa::scalar ? nullptr : SelectBlockIntersection( _options.kernelIsa ),
+        _mergeOccluders ? &plateOccluders : nullptr };
+
+    // the coordinator reports, the lightmaps go back through the exchange file:
+    _options.verbose = false;
+    _options.pCheckpointPath = nullptr;
+    _options.resume = false;
+    _options.morePasses = std::nullopt;
+    _options.pRelightPath = nullptr;
+    _options.pTrace = nullptr;
+    _options.pPreview = nullptr;
+    _options.pShard = &worker;
+    const auto Run{ [ & ]< typename T, unsigned TextureWidth >() {
+            return Solve< T, TextureWidth >( header.scene, plates, occlusion, lightSources, header.maxRenderingPass, _options );
+        } };
+    const auto lightmaps{ header.realSize == sizeof( float ) ? DispatchTextureWidth< float >( header.scene.textureWidth, Run ) : DispatchTextureWidth< double >( header.scene.textureWidth, Run ) };
+    const auto abandoned{ worker.Abandoned() };
+    if( !abandoned )
+        worker.Finish( lightmaps );
+#if defined( _WIN32 )
+    if( worker.coordinatorProcess != nullptr )
+        ::CloseHandle( worker.coordinatorProcess );
+#endif
+    return abandoned ? -1 : 0;
+}
+
+
+// lightmaps of any plate widths bilinearly resampled to a uniform width, to be compared with a uniform solve:
+Lightmaps ResampleLightmaps( const Lightmaps & _lightmaps, const unsigned _width )
+{
+    Lightmaps resampled{ _lightmaps.size(), std::size_t{ _width } * _width };
+    for( std::size_t plateIndex{ 0 }; plateIndex < _lightmaps.size(); ++plateIndex ) {
+        const auto lightmap{ _lightmaps[ plateIndex ] };
+        const auto plateWidth{ PlateWidth( _lightmaps.offsets, plateIndex ) };
+        const auto scale{ static_cast< Real >( plateWidth ) / _width };
+        const auto target{ resampled[ plateIndex ] };
+        for( unsigned y{ 0 }; y < _width; ++y )
+            for( unsigned x{ 0 }; x < _width; ++x )
+                VecArraySet( target, std::size_t{ y } * _width + x, SampleTexels( plateWidth, [ & ]( const std::size_t _texel ) { return VecArrayGet( lightmap, _texel ); },
+                    ( x + Real( 0.5 ) ) * scale - Real( 0.5 ), ( y + Real( 0.5 ) ) * scale - Real( 0.5 ) ) );
+    }
+    return resampled;
+}
+
+// lightmap differences against a reference, in lightmap units (1 is full intensity) and in 8-bit levels,
+// the total energy error telling a bias apart from noise:
+void CompareLightmaps( const char * _label, const Lightmaps & _lightmaps, const Lightmaps & _reference )
+{
+    Real maxDifference{ 0 };
+    Real sumDifference{ 0 };
+    Real sumSquaredDifference{ 0 };
+    Real energy{ 0 };
+    Real referenceEnergy{ 0 };
+    unsigned maxLevelDifference{ 0 };
+    std::size_t levelDifferenceCount{ 0 };
+    std::size_t valueCount{ 0 };
+    for( std::size_t plateIndex{ 0 }; plateIndex < _lightmaps.size(); ++plateIndex ) {
+        for( std::size_t texel{ 0 }; texel < _lightmaps[ plateIndex ].x.size(); ++texel ) {
+            const auto value{ VecArrayGet( _lightmaps[ plateIndex ], texel ) };
+            const auto referenceValue{ VecArrayGet( _reference[ plateIndex ], texel ) };
+            for( int i{ 0 }; i < 3; ++i, ++valueCount ) {
+                const auto difference{ std::abs( value[ i ] - referenceValue[ i ] ) };
+                maxDifference = std::max( maxDifference, difference );
+                sumDifference += difference;
+                sumSquaredDifference += difference * difference;
+                energy += value[ i ];
+                referenceEnergy += referenceValue[ i ];
+                const auto level{ static_cast< int >( std::clamp< Real >( value[ i ], 0, 1 ) * 255 ) };
+                const auto referenceLevel{ static_cast< int >( std::clamp< Real >( referenceValue[ i ], 0, 1 ) * 255 ) };
+                maxLevelDifference = std::max( maxLevelDifference, static_cast< unsigned >( std::abs( level - referenceLevel ) ) );
+                levelDifferenceCount += level != referenceLevel ? 1 : 0;
+            }
+        }
+    }
+    const auto count{ static_cast< Real >( std::max< std::size_t >( valueCount, 1 ) ) };
+    std::cout << _label << ": max difference " << maxDifference << ", mean difference " << sumDifference / count << ", RMS " << std::sqrt( sumSquaredDifference / count )
+              << ", total energy error " << ( referenceEnergy > 0 ? 100 * ( energy - referenceEnergy ) / referenceEnergy : 0 ) << "%"
+              << ", max 8-bit level difference " << maxLevelDifference << " (" << levelDifferenceCount << "/" << valueCount << " values)" << std::endl;
+}
+
+
+// benchmark suite written as JSON, every benchmark carrying what it ran on, seeds and scene included, so that runs compare over time:
+// micro-benchmarks of the geometry helpers and of the pass bookkeeping, then solves sweeping the scene size, the depth,
+// the texture resolution (powers of two up to the given one) and the thread count around the given scene, the best of 3 runs being kept:
+int BenchSuite( const char * _path, const Scene & _scene, const std::vector< Photon< Real > > & _lightSources, const unsigned _maxRenderingPass,
+    Options _options, const bool _singlePrecision, const bool _bruteForce, const bool _mergeOccluders )
+{
+    _options.verbose = false;
+    _options.pCheckpointPath = nullptr;
+    _options.resume = false;
+    _options.morePasses.reset();
+    _options.pRelightPath = nullptr;
+    std::ofstream json{ _path, std::ios::trunc };
+    if( !json ) {
+        std::cerr << "Failed to create benchmark file " << _path << std::endl;
+        return -1;
+    }
+    json.precision( 10 );
+    const auto hardwareThreadCount{ std::max( std::thread::hardware_concurrency(), 1u ) };
+    json << "{\n  \"suite\": \"lightshot\", \"version\": 2,\n";
+    json << "  \"kernel\": \"" << KernelIsaName( _options.kernelIsa ) << "\", \"precision\": \"" << ( _singlePrecision ? "single" : "double" ) << "\", \"hardwareThreads\": " << hardwareThreadCount
+         << ", \"passes\": " << _maxRenderingPass << ", \"cacheBudget\": " << _options.cacheBudget << ", \"hierarchical\": ";
+    if( _options.hierarchicalThreshold )
+        json << *_options.hierarchicalThreshold;
+    else
+        json << "null";
+    json << ", \"plateTasks\": " << ( _options.plateTasks ? "true" : "false" ) << ", \"occlusion\": \"" << ( _bruteForce ? "brute force" : "bounding volume hierarchy" )
+         << "\", \"mergeOccluders\": " << ( _mergeOccluders ? "true" : "false" ) << ",\n";
+    const auto WriteScene{ [ & ]( const Scene & _benchScene ) {
+            json << "\"scene\": { \"generator\": " << sceneGeneratorVersion << ", \"width\": " << _benchScene.width << ", \"height\": " << _benchScene.height << ", \"maxDepth\": " << _benchScene.maxDepth
+                 << ", \"depthRate\": " << _benchScene.rndDepthRate << ", \"colorRate\": " << _benchScene.rndColorRate << ", \"plateWidth\": " << _benchScene.plateWidth
+                 << ", \"textureWidth\": " << _benchScene.textureWidth << ", \"retransmission\": " << _benchScene.materialRetransmission
+                 << ", \"decayDistance\": " << _benchScene.wavelengthDecayDistance << ", \"depthSeed\": " << _benchScene.depthSeed << ", \"colorSeed\": " << _benchScene.colorSeed << " }";
+        } };
+
+    // doubles the iteration count until a round lasts 100ms, the sink keeping the results alive:
+    double sink{ 0 };
+    bool first{ true };
+    const auto Measure{ [ & ]( const std::string_view _name, const unsigned _seed, const Scene * _pScene, const auto & _Body ) {
+            for( std::size_t iterations{ 1 }; ; iterations *= 2 ) {
+                const auto tBench{ std::chrono::high_resolution_clock::now() };
+                for( std::size_t i{ 0 }; i < iterations; ++i )
+                    sink += static_cast< double >( _Body( i ) );
+                const auto seconds{ std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tBench ).count() };
+                if( seconds < 0.1 )
+                    continue;
+                const auto nanoseconds{ seconds * 1000000000 / static_cast< double >( iterations ) };
+                std::cout << _name << ": " << nanoseconds << "ns" << std::endl;
+                json << ( first ? "" : ",\n" ) << "    { \"name\": \"" << _name << "\", \"seed\": " << _seed << ", ";
+                if( _pScene != nullptr ) {
+                    WriteScene( *_pScene );
+                    json << ", ";
+                }
+                json << "\"iterations\": " << iterations << ", \"nanoseconds\": " << nanoseconds << " }";
+                first = false;
+                return;
+            }
+        } };
+    json << "  \"micro\": [\n";
+
+    // random segments, triangles and vectors in the unit cube:
+    static constexpr std::size_t sampleCount{ 1024 };
+    std::vector< Vector3D > samples;
+    std::mt19937 rnd{ 1 };
+    std::uniform_real_distribution< Real > rndCoordinate( -1, 1 );
+    for( std::size_t i{ 0 }; i < sampleCount * 5; ++i )
+        samples.emplace_back( Vector3D{ rndCoordinate( rnd ), rndCoordinate( rnd ), rndCoordinate( rnd ) } );
+    Measure( "SegmentIntersectsTriangle", 1, nullptr, [ & ]( const std::size_t _i ) {
+            const auto * const pSample{ &samples[ _i % sampleCount * 5 ] };
+            return SegmentIntersectsTriangle( pSample[ 0 ], pSample[ 1 ], pSample[ 2 ], pSample[ 3 ], pSample[ 4 ] ) ? 1 : 0;
+        } );
+    Measure( "VecCross+VecNorm+VecDot+VecDist", 1, nullptr, [ & ]( const std::size_t _i ) {
+            const auto & a{ samples[ _i % sampleCount ] };
+            const auto & b{ samples[ ( _i + 1 ) % sampleCount ] };
+            return VecDot( VecNorm( VecCross( a, b ) ), VecAdd( VecSub( a, b ), VecMult( a, Real{ 0.5 } ) ) ) + VecDist( a, b );
+        } );
+    const auto depthsMap{ GenerateDepthsMap( _scene ) };
+    Measure( "GeneratePlates", _scene.colorSeed, &_scene, [ & ]( const std::size_t ) { return GeneratePlates( _scene, depthsMap ).size(); } );
+
+    // every pass ends converting the emitters, a quarter of them being dark here:
+    const auto plates{ GeneratePlates( _scene, depthsMap ) };
+    const auto BenchConversion{ [ & ]< typename T, unsigned TextureWidth >() {
+            const auto transport{ MakeTransport< T >( _scene, plates, nullptr ) };
+            auto atlas{ PrepareTexels< T, TextureWidth >( _scene, plates ) };
+            std::mt19937 rndEnergy{ 2 };
+            std::uniform_real_distribution< T > rndValue( 0, 1 );
+            for( std::size_t texel{ 0 }; texel < atlas.offsets.back(); ++texel )
+                VecArraySet( atlas.emitters, texel, rndEnergy() % 4 == 0 ? Vector3< T >{ 0, 0, 0 } : Vector3< T >{ rndValue( rndEnergy ), rndValue( rndEnergy ), rndValue( rndEnergy ) } );
+            const auto emitters{ atlas.emitters };
+            std::vector< Photon< T > > photons;
+            std::vector< Photon< T > > nextPhotons;
+            std::vector< unsigned > photonIndices;
+            PhotonCompaction< T, TextureWidth > compaction{ transport, atlas };
+            TaskPool pool{ _options.threadCount };
+            Measure( "EmittersToPhotons", 2, &_scene, [ & ]( const std::size_t ) {
+                    std::copy( emitters.x.begin(), emitters.x.end(), atlas.emitters.x.begin() );
+                    std::copy( emitters.y.begin(), emitters.y.end(), atlas.emitters.y.begin() );
+                    std::copy( emitters.z.begin(), emitters.z.end(), atlas.emitters.z.begin() );
+                    EmittersToPhotons( compaction, photons, nextPhotons, photonIndices, pool );
+                    return photons.size();
+                } );
+        } };
+    _singlePrecision ? DispatchTextureWidth< float >( _scene.textureWidth, BenchConversion ) : DispatchTextureWidth< double >( _scene.textureWidth, BenchConversion );
+    json << "\n  ],\n  \"macro\": [\n";
+
+    // full solves, the received energy total telling whether the results moved:
+    first = true;
+    const auto Sweep{ [ & ]( const std::string_view _name, const Scene & _benchScene, const unsigned _threadCount ) {
+            const auto benchPlates{ GeneratePlates( _benchScene, GenerateDepthsMap( _benchScene ) ) };
+            std::vector< unsigned > plateOccluders;
+            const auto occluders{ _mergeOccluders ? MergeOccluders( benchPlates, plateOccluders ) : PlateQuads( benchPlates ) };
+            const auto occlusionTree{ BuildOcclusionTree( occluders ) };
+            const Occlusion occlusion{ occluders, occlusionTree, _bruteForce, _options.kernelIsa == KernelIsa::scalar ? nullptr : SelectBlockIntersection( _options.kernelIsa ),
+                _mergeOccluders ? &plateOccluders : nullptr };
+            auto options{ _options };
+            options.threadCount = _threadCount;
+            const auto Run{ [ & ]< typename T, unsigned TextureWidth >() {
+                    return Solve< T, TextureWidth >( _benchScene, benchPlates, occlusion, _lightSources, _maxRenderingPass, options );
+                } };
+            double seconds{ std::numeric_limits< double >::max() };
+            Real energy{ 0 };
+            for( unsigned run{ 0 }; run < 3; ++run ) {
+                const auto tBench{ std::chrono::high_resolution_clock::now() };
+                const auto lightmaps{ _singlePrecision ? DispatchTextureWidth< float >( _benchScene.textureWidth, Run ) : DispatchTextureWidth< double >( _benchScene.textureWidth, Run ) };
+                seconds = std::min( seconds, std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tBench ).count() );
+                const auto & texels{ lightmaps.texels };
+                energy = std::accumulate( texels.x.begin(), texels.x.end(), Real{ 0 } ) + std::accumulate( texels.y.begin(), texels.y.end(), Real{ 0 } )
+                       + std::accumulate( texels.z.begin(), texels.z.end(), Real{ 0 } );
+            }
+            std::cout << _name << " " << _benchScene.width << "x" << _benchScene.height << ", depth " << _benchScene.maxDepth << ", resolution " << _benchScene.textureWidth
+                      << ", " << _threadCount << " thread(s): " << benchPlates.size() << " plates, " << occluders.size() << " occluders, " << seconds << "s" << std::endl;
+            json << ( first ? "" : ",\n" ) << "    { \"name\": \"" << _name << "\", ";
+            WriteScene( _benchScene );
+            json << ", \"threads\": " << _threadCount << ", \"plates\": " << benchPlates.size() << ", \"occluders\": " << occluders.size() << ", \"seconds\": " << seconds << ", \"energy\": " << energy << " }";
+            first = false;
+        } };
+    for( const auto size : { std::max( _scene.width, 4u ) - 3, _scene.width, _scene.width + 3 } ) {
+        auto benchScene{ _scene };
+        benchScene.width = benchScene.height = size;
+        Sweep( "scene-size", benchScene, _options.threadCount );
+    }
+    for( unsigned maxDepth{ 1 }; maxDepth <= _scene.maxDepth + 1; ++maxDepth ) {
+        auto benchScene{ _scene };
+        benchScene.maxDepth = maxDepth;
+        Sweep( "max-depth", benchScene, _options.threadCount );
+    }
+    for( unsigned textureWidth{ 2 }; textureWidth <= _scene.textureWidth; textureWidth *= 2 ) {
+        auto benchScene{ _scene };
+        benchScene.textureWidth = textureWidth;
+        Sweep( "texture-resolution", benchScene, _options.threadCount );
+    }
+    for( unsigned threadCount{ 1 }; threadCount < hardwareThreadCount * 2; threadCount *= 2 )
+        Sweep( "thread-count", _scene, std::min( threadCount, hardwareThreadCount ) );
+    json << "\n  ],\n  \"sink\": " << sink << "\n}\n";
+    json.close();
+    if( !json ) {
+        std::cerr << "Failed to write benchmark file " << _path << std::endl;
+        return -1;
+    }
+    std::cout << "benchmark file: " << _path << std::endl;
+    return 0;
+}
+
+
+// occluder merging on growing random depth maps: plate and occluder counts, then the first pass of the stochastic transport with and
+// without merging, its fixed ray count keeping the pass comparable across sizes where the exhaustive one would not end,
+// at a resolution low enough for the texel buffers of the largest map to fit:
+int BenchOccluders( const Scene & _scene, const std::vector< Photon< Real > > & _lightSources, Options _options, const bool _singlePrecision, const bool _bruteForce )
+{
+    _options.verbose = false;
+    _options.pCheckpointPath = nullptr;
+    _options.pRelightPath = nullptr;
+    _options.pTrace = nullptr;
+    _options.monteCarloRays = _options.monteCarloRays != 0 ? _options.monteCarloRays : 262144;
+    _options.monteCarloIterations = 1;
+    _options.monteCarloSeconds = std::nullopt;
+    std::cout << "occluder merging, " << _options.monteCarloRays << " stochastic ray(s) per pass:" << std::endl;
+    for( const auto size : { _scene.width, 64u, 256u } ) {
+        auto benchScene{ _scene };
+        benchScene.width = benchScene.height = size;
+        benchScene.textureWidth = std::min( _scene.textureWidth, 4u );
+        const auto benchPlates{ GeneratePlates( benchScene, GenerateDepthsMap( benchScene ) ) };
+        const auto tMerge{ std::chrono::high_resolution_clock::now() };
+        std::vector< unsigned > plateOccluders;
+        const auto occluders{ MergeOccluders( benchPlates, plateOccluders ) };
+        const auto mergeDuration{ std::chrono::duration< double, std::milli >( std::chrono::high_resolution_clock::now() - tMerge ).count() };
+        std::cout << size << "x" << size << ": " << benchPlates.size() << " plates, " << occluders.size() << " occluders (merged in " << mergeDuration << "ms), pass ";
+        std::array< double, 2 > seconds{ 0, 0 };
+        const auto plateQuads{ PlateQuads( benchPlates ) };
+        for( const bool merge : { false, true } ) {
+            const auto & occluderQuads{ merge ? occluders : plateQuads };
+            const auto occlusionTree{ BuildOcclusionTree( occluderQuads ) };
+            const Occlusion occlusion{ occluderQuads, occlusionTree, _bruteForce, _options.kernelIsa == KernelIsa::scalar ? nullptr : SelectBlockIntersection( _options.kernelIsa ),
+                merge ? &plateOccluders : nullptr };
+            const auto Run{ [ & ]< typename T, unsigned TextureWidth >() {
+                    return SolveMonteCarlo< T, TextureWidth >( benchScene, benchPlates, occlusion, _lightSources, 1, _options );
+                } };
+            const auto tBench{ std::chrono::high_resolution_clock::now() };
+            _singlePrecision ? DispatchTextureWidth< float >( benchScene.textureWidth, Run ) : DispatchTextureWidth< double >( benchScene.textureWidth, Run );
+            seconds[ merge ? 1 : 0 ] = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tBench ).count();
+        }
+        std::cout << seconds[ 0 ] << "s with plates, " << seconds[ 1 ] << "s with occluders (x" << seconds[ 0 ] / seconds[ 1 ] << ")" << std::endl;
+    }
+    return 0;
+}
+
+// peak resident memory of the process so far, in megabytes:
+inline static double PeakResidentMegabytes()
+{
+#if defined( _WIN32 )
+    PROCESS_MEMORY_COUNTERS counters{};
+    ::GetProcessMemoryInfo( ::GetCurrentProcess(), &counters, sizeof( counters ) );
+    return static_cast< double >( counters.PeakWorkingSetSize ) / ( 1024 * 1024 );
+#else
+    rusage usage{};
+    ::getrusage( RUSAGE_SELF, &usage );
+#if defined( __APPLE__ )
+    return static_cast< double >( usage.ru_maxrss ) / ( 1024 * 1024 ); // bytes
+#else
+    return static_cast< double >( usage.ru_maxrss ) / 1024; // kilobytes
+#endif
+#endif
+}
+
+// scene generation on square grids doubling up to the given size: depths map and plates durations, and the peak resident memory
+// once the plates exist, the previous grids being released so that the peak is the one of the largest grid so far:
+int BenchGeneration( const Scene & _scene, const unsigned _maxSize )
+{
+    std::cout << "scene generation, " << std::max( std::thread::hardware_concurrency(), 1u ) << " hardware thread(s), " << sizeof( Plate ) << " bytes per plate:" << std::endl;
+    for( unsigned size{ 256 }; size <= _maxSize; size *= 2 ) {
+        auto benchScene{ _scene };
+        benchScene.width = benchScene.height = size;
+        const auto t0{ std::chrono::high_resolution_clock::now() };
+        const auto depthsMap{ GenerateDepthsMap( benchScene ) };
+        const auto t1{ std::chrono::high_resolution_clock::now() };
+        const auto plates{ GeneratePlates( benchScene, depthsMap ) };
+        const auto t2{ std::chrono::high_resolution_clock::now() };
+        std::cout << size << "x" << size << ": " << plates.size() << " plates, depths map " << std::chrono::duration< double, std::milli >( t1 - t0 ).count()
+                  << "ms, plates " << std::chrono::duration< double, std::milli >( t2 - t1 ).count() << "ms, "
+                  << static_cast< double >( plates.size() * sizeof( Plate ) ) / ( 1024 * 1024 ) << "MB of plates, peak resident memory " << PeakResidentMegabytes() << "MB" << std::endl;
+    }
+    return 0;
+}
+
+// whole scene of a lightmap image drawn by one call from the atlas texture, in the current context, the program, the buffers,
+// the uniform locations and the sampler state being set once:
+struct LightmapRenderer
+{
+    unsigned int shaderProgram{ 0 };
+    unsigned int vertexArray{ 0 };
+    unsigned int verticesBufferObject{ 0 };
+    unsigned int indicesBufferObject{ 0 };
+    unsigned int atlasTexture{ 0 };
+    GLint modelLocation{ -1 };
+    GLsizei indexCount{ 0 };
+
+    // returns false when the atlas exceeds the maximum texture size of the context:
+    bool Create( const LightmapView & _lightmap, const float _aspectRatio, Trace * _pTrace )
+    {
+        const auto & header{ *_lightmap.pHeader };
+        GLint maxTextureSize{ 0 };
+        ::glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxTextureSize );
+        if( header.atlasWidth > static_cast< unsigned >( maxTextureSize ) || header.atlasHeight > static_cast< unsigned >( maxTextureSize ) ) {
+            std::cerr << "Lightmap atlas of " << header.atlasWidth << "x" << header.atlasHeight << " exceeds the maximum texture size " << maxTextureSize << std::endl;
+            return false;
+        }
+
+        auto vertexShader{ ::glCreateShader( GL_VERTEX_SHADER ) };
+        const char * pVertexShaderSource{ R"_(
+            #version 330 core
+            layout ( location = 0 ) in vec3 aPos;
+            layout ( location = 1 ) in vec2 aTexCoord;
+
+            out vec2 TexCoord;
+
+            uniform mat4 model;
+            uniform mat4 view;
+            uniform mat4 projection;
+
+            void main()
+            {
+                gl_Position = projection * view * model * vec4( aPos, 1.0 );
+                TexCoord = aTexCoord;
+            }
+        )_" };
+        ::glShaderSource( vertexShader, 1, &pVertexShaderSource, nullptr );
+        ::glCompileShader( vertexShader );
+
+        auto fragmentShader{ ::glCreateShader( GL_FRAGMENT_SHADER ) };
+        const char * pFragmentShaderSource{ R"_(
+            #version 330 core
+            in vec2 TexCoord;
+            out vec4 FragColor;
+
+            uniform sampler2D faceTexture;
+
+            void main() {
+                FragColor = texture( faceTexture, TexCoord );
+            }
+        )_" };
+        ::glShaderSource( fragmentShader, 1, &pFragmentShaderSource, nullptr );
+        ::glCompileShader( fragmentShader );
+
+        shaderProgram = ::glCreateProgram();
+        ::glAttachShader( shaderProgram, vertexShader );
+        ::glAttachShader( shaderProgram, fragmentShader );
+        ::glLinkProgram( shaderProgram );
+        ::glDeleteShader( vertexShader );
+        ::glDeleteShader( fragmentShader );
+        ::glUseProgram( shaderProgram );
+
+        // the view and the projection do not change, the camera being as far as the scene is wide:
+        const auto cameraDepth{ static_cast< float >( std::max( header.sceneWidth, header.sceneHeight ) ) * header.plateWidth };
+        const ::glm::mat4 view{ ::glm::translate( ::glm::mat4{ 1.0f }, ::glm::vec3{ 0.0f, 0.0f, -cameraDepth } ) };
+        const ::glm::mat4 projection{ ::glm::perspective( ::glm::radians( 45.0f ), _aspectRatio, 0.1f, std::max( 100.0f, cameraDepth * 2 ) ) };
+        modelLocation = ::glGetUniformLocation( shaderProgram, "model" );
+        ::glUniformMatrix4fv( ::glGetUniformLocation( shaderProgram, "view" ), 1, GL_FALSE, ::glm::value_ptr( view ) );
+        ::glUniformMatrix4fv( ::glGetUniformLocation( shaderProgram, "projection" ), 1, GL_FALSE, ::glm::value_ptr( projection ) );
+
+        // the positions and the texture coordinates of the image are uploaded as they are, one after the other:
+        ScopedTimer uploadTimer{ _pTrace, "GL upload" };
+        const auto positionsSize{ static_cast< GLsizeiptr >( header.plateCount * 4 * 3 * sizeof( float ) ) };
+        const auto texturesSize{ static_cast< GLsizeiptr >( header.plateCount * 4 * 2 * sizeof( float ) ) };
+        std::vector< unsigned int > indices;
+        indices.reserve( header.plateCount * 6 );
+        for( unsigned int plateIndex{ 0 }; plateIndex < header.plateCount; ++plateIndex )
+            for( const auto i : { 0u, 1u, 2u, 2u, 3u, 0u } )
+                indices.emplace_back( plateIndex * 4 + i );
+        indexCount = static_cast< GLsizei >( indices.size() );
+
+        ::glGenVertexArrays( 1, &vertexArray );
+        ::glGenBuffers( 1, &verticesBufferObject );
+        ::glGenBuffers( 1, &indicesBufferObject );
+        ::glBindVertexArray( vertexArray );
+        ::glBindBuffer( GL_ARRAY_BUFFER, verticesBufferObject );
+        ::glBufferData( GL_ARRAY_BUFFER, positionsSize + texturesSize, nullptr, GL_STATIC_DRAW );
+        ::glBufferSubData( GL_ARRAY_BUFFER, 0, positionsSize, _lightmap.positions );
+        ::glBufferSubData( GL_ARRAY_BUFFER, positionsSize, texturesSize, _lightmap.textures );
+        ::glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indicesBufferObject );
+        ::glBufferData( GL_ELEMENT_ARRAY_BUFFER, static_cast< GLsizeiptr >( indices.size() * sizeof( unsigned int ) ), indices.data(), GL_STATIC_DRAW );
+        ::glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof( float ), ( void * ) 0 );
+        ::glEnableVertexAttribArray( 0 );
+        ::glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof( float ), ( void * ) positionsSize );
+        ::glEnableVertexAttribArray( 1 );
+
+        // the atlas is one texture, uploaded at once:
+        ::glGenTextures( 1, &atlasTexture );
+        ::glBindTexture( GL_TEXTURE_2D, atlasTexture );
+        ::glPixelStorei( GL_UNPACK_ALIGNMENT, 1 ); // rows of 3-byte texels
+        ::glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, static_cast< GLsizei >( header.atlasWidth ), static_cast< GLsizei >( header.atlasHeight ), 0, GL_RGB, GL_UNSIGNED_BYTE, _lightmap.colors );
+        ::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+        ::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+        SetNearestFiltering( false );
+        ::glFinish(); // the upload is over once timed
+
+        ::glEnable( GL_DEPTH_TEST );
+        ::glClearColor( 0, 0, 0, 1 );
+        return true;
+    }
+
+    // nearest or linear interpolation:
+    void SetNearestFiltering( const bool _nearest ) const
+    {
+        ::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, _nearest ? GL_NEAREST : GL_LINEAR );
+        ::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, _nearest ? GL_NEAREST : GL_LINEAR );
+    }
+
+    // the scene turned by this angle around its vertical axis:
+    void Draw( const float _angle ) const
+    {
+        ::glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+        ::glm::mat4 model{ ::glm::mat4{ 1.0f } };
+        model = ::glm::rotate( model, ::glm::radians( 120.0f ), ::glm::vec3{ 1.0f, 0.0f, 0.0f } );
+        model = ::glm::rotate( model, _angle, ::glm::vec3{ 0.0f, 0.0f, 1.0f } );
+        ::glUniformMatrix4fv( modelLocation, 1, GL_FALSE, ::glm::value_ptr( model ) );
+        ::glDrawElements( GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr );
+    }
+
+    void Destroy()
+    {
+        ::glDeleteTextures( 1, &atlasTexture );
+        ::glDeleteBuffers( 1, &indicesBufferObject );
+        ::glDeleteBuffers( 1, &verticesBufferObject );
+        ::glDeleteVertexArrays( 1, &vertexArray );
+        ::glDeleteProgram( shaderProgram );
+    }
+};
+
+// interactive viewer of a lightmap image, computed or loaded from a file, the tiles of the preview replacing the image ones
+// as they are published:
+int ViewLightmap( const LightmapView & _lightmap, Trace * _pTrace, LightmapPreview * _pPreview )
+{
+    if( !::glfwInit() ) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
+
+    ::glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 3 );
+    ::glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
+    ::glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
+
+    const int screenWidth{ 1600 };
+    const int screenHeight{ 1200 };
+
+    GLFWwindow * const pWindow{ ::glfwCreateWindow( screenWidth, screenHeight, "LightShot", nullptr, nullptr ) };
+    if( pWindow == nullptr ) {
+        std::cerr << "Failed to create GLFW window" << std::endl;
+        ::glfwTerminate();
+        return -1;
+    }
+
+    ::glfwMakeContextCurrent( pWindow );
+    ::glfwSetFramebufferSizeCallback( pWindow, []( GLFWwindow *, int _width, int _height ){
+            ::glViewport( 0, 0, _width, _height );
+        } );
+
+    if( !::gladLoadGLLoader( reinterpret_cast< GLADloadproc >( ::glfwGetProcAddress ) ) ) {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    LightmapRenderer renderer;
+    if( !renderer.Create( _lightmap, static_cast< float >( screenWidth ) / screenHeight, _pTrace ) ) {
+        ::glfwTerminate();
+        return -1;
+    }
+
+    bool nearestTextureRendering{ false }; // nearest or linear interpolation
     bool switchNearestTextureRendering{ false };
     while( !::glfwWindowShouldClose( pWindow ) ) {
         if( ::glfwGetKey( pWindow, GLFW_KEY_ESCAPE ) == GLFW_PRESS )
@@ -559,38 +4958,760 @@ int main( int _argc, char * _argv[] )
         if( ::glfwGetKey( pWindow, GLFW_KEY_SPACE ) == GLFW_RELEASE && switchNearestTextureRendering ) {
             switchNearestTextureRendering = false;
             nearestTextureRendering = !nearestTextureRendering;
+            renderer.SetNearestFiltering( nearestTextureRendering );
         }
-        
-        ::glClearColor( 0, 0, 0, 1 );
-        ::glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-        ::glUseProgram( shaderProgram );
-        
-        float angle{ static_cast< float >( ::glfwGetTime() ) * 0.5f };
-
-        ::glm::mat4 model{ ::glm::mat4{ 1.0f } };
-        model = ::glm::rotate( model, ::glm::radians( 120.0f ), ::glm::vec3{ 1.0f, 0.0f, 0.0f } );
-        model = ::glm::rotate( model, angle, ::glm::vec3{ 0.0f, 0.0f, 1.0f } );
-
-        ::glm::mat4 view{ ::glm::translate( ::glm::mat4{ 1.0f }, ::glm::vec3{ 0.0f, 0.0f, -cameraDepth } ) };
-        ::glm::mat4 projection{ ::glm::perspective( ::glm::radians( 45.0f ), static_cast< float >( screenWidth ) / screenHeight, 0.1f, 100.0f ) };
-
-        ::glUniformMatrix4fv( ::glGetUniformLocation( shaderProgram, "model" ), 1, GL_FALSE, ::glm::value_ptr( model ) );
-        ::glUniformMatrix4fv( ::glGetUniformLocation( shaderProgram, "view" ), 1, GL_FALSE, ::glm::value_ptr( view ) );
-        ::glUniformMatrix4fv( ::glGetUniformLocation( shaderProgram, "projection" ), 1, GL_FALSE, ::glm::value_ptr( projection ) );
 
-        for( int i{ 0 }; i < plates.size(); ++i ) {
-            glBindTexture( GL_TEXTURE_2D, textures[ i ] );
-            ::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, nearestTextureRendering ? GL_NEAREST : GL_LINEAR );
-            ::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, nearestTextureRendering ? GL_NEAREST : GL_LINEAR );
-            ::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-            ::glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-            glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, ( void * )( i * 6 * sizeof( unsigned int ) ) );
-        }
+        if( _pPreview != nullptr )
+            _pPreview->Upload();
+        renderer.Draw( static_cast< float >( ::glfwGetTime() ) * 0.5f );
+        if( _pPreview != nullptr )
+            _pPreview->FrameDrawn( _pTrace );
 
         ::glfwSwapBuffers( pWindow );
         ::glfwPollEvents();
     }
 
+    renderer.Destroy();
     ::glfwTerminate();
     return 0;
 }
+
+// EGL entry points of the system library, which exports them all, loaded at once:
+struct EglLibrary
+{
+    void * pHandle{ nullptr };
+    PFNEGLGETPROCADDRESSPROC GetProcAddress{ nullptr };
+    PFNEGLGETDISPLAYPROC GetDisplay{ nullptr };
+    PFNEGLINITIALIZEPROC Initialize{ nullptr };
+    PFNEGLTERMINATEPROC Terminate{ nullptr };
+    PFNEGLQUERYSTRINGPROC QueryString{ nullptr };
+    PFNEGLCHOOSECONFIGPROC ChooseConfig{ nullptr };
+    PFNEGLBINDAPIPROC BindAPI{ nullptr };
+    PFNEGLCREATEPBUFFERSURFACEPROC CreatePbufferSurface{ nullptr };
+    PFNEGLDESTROYSURFACEPROC DestroySurface{ nullptr };
+    PFNEGLCREATECONTEXTPROC CreateContext{ nullptr };
+    PFNEGLDESTROYCONTEXTPROC DestroyContext{ nullptr };
+    PFNEGLMAKECURRENTPROC MakeCurrent{ nullptr };
+    PFNEGLGETERRORPROC GetError{ nullptr };
+
+    EglLibrary() = default;
+    EglLibrary( const EglLibrary & ) = delete;
+    EglLibrary & operator =( const EglLibrary & ) = delete;
+
+    ~EglLibrary()
+    {
+        if( pHandle == nullptr )
+            return;
+#if defined( _WIN32 )
+        ::FreeLibrary( static_cast< HMODULE >( pHandle ) );
+#else
+        ::dlclose( pHandle );
+#endif
+    }
+
+    // returns false when the library or one of its entry points is missing:
+    bool Load()
+    {
+#if defined( _WIN32 )
+        pHandle = ::LoadLibraryA( "libEGL.dll" );
+        const auto Symbol{ [ & ]( const char * _pName ) { return reinterpret_cast< void * >( ::GetProcAddress( static_cast< HMODULE >( pHandle ), _pName ) ); } };
+#else
+        pHandle = ::dlopen( "libEGL.so.1", RTLD_NOW | RTLD_LOCAL );
+        const auto Symbol{ [ & ]( const char * _pName ) { return ::dlsym( pHandle, _pName ); } };
+#endif
+        if( pHandle == nullptr )
+            return false;
+        bool loaded{ true };
+        const auto Bind{ [ & ]< typename F >( F & _function, const char * _pName ) {
+                _function = reinterpret_cast< F >( Symbol( _pName ) );
+                loaded = loaded && _function != nullptr;
+            } };
+        Bind( GetProcAddress, "eglGetProcAddress" );
+        Bind( GetDisplay, "eglGetDisplay" );
+        Bind( Initialize, "eglInitialize" );
+        Bind( Terminate, "eglTerminate" );
+        Bind( QueryString, "eglQueryString" );
+        Bind( ChooseConfig, "eglChooseConfig" );
+        Bind( BindAPI, "eglBindAPI" );
+        Bind( CreatePbufferSurface, "eglCreatePbufferSurface" );
+        Bind( DestroySurface, "eglDestroySurface" );
+        Bind( CreateContext, "eglCreateContext" );
+        Bind( DestroyContext, "eglDestroyContext" );
+        Bind( MakeCurrent, "eglMakeCurrent" );
+        Bind( GetError, "eglGetError" );
+        return loaded;
+    }
+};
+
+// turntable of a lightmap image rendered without window into an EGL pbuffer, one binary PPM file per frame named after the prefix
+// and the frame index, then the frame times, the draw being timed up to its completion apart from the read back; the tiles of the
+// preview replace the image ones as they are published, the last frame showing the final lightmaps:
+int RenderLightmapFrames( const LightmapView & _lightmap, const unsigned _frameCount, const std::string & _prefix, const int _width, const int _height, Trace * _pTrace,
+    LightmapPreview * _pPreview )
+{
+    EglLibrary egl;
+    if( !egl.Load() ) {
+        std::cerr << "Failed to load the EGL library" << std::endl;
+        return -1;
+    }
+
+    // the default display, or the surfaceless platform on machines without display server:
+    EGLDisplay display{ egl.GetDisplay( EGL_DEFAULT_DISPLAY ) };
+    if( display == EGL_NO_DISPLAY || !egl.Initialize( display, nullptr, nullptr ) ) {
+        const char * const pClientExtensions{ egl.QueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS ) };
+        const auto GetPlatformDisplay{ reinterpret_cast< PFNEGLGETPLATFORMDISPLAYEXTPROC >( egl.GetProcAddress( "eglGetPlatformDisplayEXT" ) ) };
+        display = pClientExtensions != nullptr && std::string_view{ pClientExtensions }.find( "EGL_MESA_platform_surfaceless" ) != std::string_view::npos
+               && GetPlatformDisplay != nullptr ? GetPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr ) : EGL_NO_DISPLAY;
+        if( display == EGL_NO_DISPLAY || !egl.Initialize( display, nullptr, nullptr ) ) {
+            std::cerr << "Failed to initialize an EGL display (error 0x" << std::hex << egl.GetError() << std::dec << ")" << std::endl;
+            return -1;
+        }
+    }
+
+    const EGLint configAttributes[]{ EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24, EGL_NONE };
+    const EGLint surfaceAttributes[]{ EGL_WIDTH, _width, EGL_HEIGHT, _height, EGL_NONE };
+    const EGLint contextAttributes[]{ EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3, EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE };
+    EGLConfig config{ nullptr };
+    EGLint configCount{ 0 };
+    EGLSurface surface{ EGL_NO_SURFACE };
+    EGLContext context{ EGL_NO_CONTEXT };
+    const auto Release{ [ & ]( const int _result ) {
+            egl.MakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+            if( context != EGL_NO_CONTEXT )
+                egl.DestroyContext( display, context );
+            if( surface != EGL_NO_SURFACE )
+                egl.DestroySurface( display, surface );
+            egl.Terminate( display );
+            return _result;
+        } };
+    if( !egl.ChooseConfig( display, configAttributes, &config, 1, &configCount ) || configCount == 0 || !egl.BindAPI( EGL_OPENGL_API )
+     || ( surface = egl.CreatePbufferSurface( display, config, surfaceAttributes ) ) == EGL_NO_SURFACE
+     || ( context = egl.CreateContext( display, config, EGL_NO_CONTEXT, contextAttributes ) ) == EGL_NO_CONTEXT
+     || !egl.MakeCurrent( display, surface, surface, context ) ) {
+        std::cerr << "Failed to create an OpenGL 3.3 pbuffer context (error 0x" << std::hex << egl.GetError() << std::dec << ")" << std::endl;
+        return Release( -1 );
+    }
+
+    if( !::gladLoadGLLoader( reinterpret_cast< GLADloadproc >( egl.GetProcAddress ) ) ) {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        return Release( -1 );
+    }
+    std::cout << "offscreen renderer: " << ::glGetString( GL_RENDERER ) << ", " << _width << "x" << _height << std::endl;
+
+    LightmapRenderer renderer;
+    if( !renderer.Create( _lightmap, static_cast< float >( _width ) / static_cast< float >( _height ), _pTrace ) )
+        return Release( -1 );
+    ::glViewport( 0, 0, _width, _height );
+    ::glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+
+    std::vector< double > frameDurations;
+    double readDuration{ 0 };
+    std::vector< unsigned char > pixels( static_cast< std::size_t >( _width ) * static_cast< std::size_t >( _height ) * 3 );
+    for( unsigned frame{ 0 }; frame < _frameCount; ++frame ) {
+        // every frame of a preview shows fresh tiles, unless they are final:
+        if( _pPreview != nullptr )
+            while( !_pPreview->complete.load( std::memory_order_acquire ) && ( frame + 1 == _frameCount || !_pPreview->Fresh() ) )
+                std::this_thread::sleep_for( std::chrono::milliseconds{ 10 } );
+        ScopedTimer frameTimer{ _pTrace, "frame " + std::to_string( frame ) };
+        if( _pPreview != nullptr )
+            _pPreview->Upload();
+        const auto t0{ std::chrono::high_resolution_clock::now() };
+        renderer.Draw( 2 * std::numbers::pi_v< float > * static_cast< float >( frame ) / static_cast< float >( _frameCount ) );
+        ::glFinish();
+        const auto t1{ std::chrono::high_resolution_clock::now() };
+        if( _pPreview != nullptr )
+            _pPreview->FrameDrawn( _pTrace );
+        ::glReadPixels( 0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data() );
+
+        // rows from the top down:
+        const auto frameName{ std::to_string( frame ) };
+        const auto path{ _prefix + std::string( frameName.size() < 4 ? 4 - frameName.size() : 0, '0' ) + frameName + ".ppm" };
+        std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+        file << "P6\n" << _width << " " << _height << "\n255\n";
+        const auto rowSize{ static_cast< std::streamsize >( _width ) * 3 };
+        for( int row{ _height }; row-- > 0; )
+            file.write( reinterpret_cast< const char * >( pixels.data() ) + row * rowSize, rowSize );
+        file.close();
+        if( !file ) {
+            std::cerr << "Failed to write frame " << path << std::endl;
+            renderer.Destroy();
+            return Release( -1 );
+        }
+        frameDurations.emplace_back( std::chrono::duration< double, std::milli >( t1 - t0 ).count() );
+        readDuration += std::chrono::duration< double, std::milli >( std::chrono::high_resolution_clock::now() - t1 ).count();
+    }
+    renderer.Destroy();
+
+    if( !frameDurations.empty() ) {
+        const auto mean{ std::accumulate( frameDurations.begin(), frameDurations.end(), 0.0 ) / static_cast< double >( frameDurations.size() ) };
+        std::sort( frameDurations.begin(), frameDurations.end() );
+        std::cout << _frameCount << " frame(s) of " << _lightmap.pHeader->plateCount << " plates in one draw call, frame time: " << frameDurations.front() << "ms min, "
+                  << frameDurations[ frameDurations.size() / 2 ] << "ms median, " << mean << "ms mean, " << frameDurations.back() << "ms max, read back and write: "
+                  << readDuration / static_cast< double >( frameDurations.size() ) << "ms per frame" << std::endl;
+        std::cout << "frames: " << _prefix << "0000.ppm.." << std::endl;
+    }
+    return Release( 0 );
+}
+
+
+int main( int _argc, char * _argv[] )
+{
+    // worker processes of the sharded solve report their failures only:
+    if( std::any_of( _argv + 1, _argv + _argc, []( const char * _pArg ) { return std::string_view{ _pArg } == "--shard-worker"; } ) )
+        std::cout.setstate( std::ios_base::badbit );
+
+    std::cout << "[lightshot] a CPU-based photon tracer" << std::endl << std::endl;
+    unsigned defaultResolution{ 16 };
+    std::cout << "usage: Lightshot resolution (must be a power of two, default is " << defaultResolution << ")" << std::endl;
+
+    std::cout << "       --brute-force: test every plate for occlusion instead of using the occlusion tree, implies --no-merge (validation)" << std::endl;
+    std::cout << "       --no-merge: test the plates for occlusion instead of merging the coplanar ones into larger occluders (validation)," << std::endl;
+    std::cout << "                   merged runs differing slightly from the plates on the rays grazing the edges between them" << std::endl;
+    std::cout << "       --bench-occluders: compare occluder counts and stochastic pass times with and without merging on growing depth maps, and exit" << std::endl;
+    std::cout << "       --cache-budget megabytes: memory allowed to the texel visibility cache, 0 to always trace (default is 1024)" << std::endl;
+    std::cout << "       --kernel scalar|avx2|avx512: force the transport kernel instruction set (default is the best supported)" << std::endl;
+    std::cout << "       --bench-kernels: measure texels/second of every supported transport kernel and exit" << std::endl;
+    std::cout << "       --check-packets count: compare packet and scalar triangle tests on random segments and exit" << std::endl;
+    std::cout << "       --hierarchical threshold: shoot emitter clusters instead of every emitter texel from the second pass on," << std::endl;
+    std::cout << "                                 refining while width / distance * energy share exceeds the threshold (e.g. 0.1)" << std::endl;
+    std::cout << "       --float: run the transport in single precision, geometry and occlusion stay in double precision" << std::endl;
+    std::cout << "       --compare-precision: run the transport in both precisions and print the lightmap differences" << std::endl;
+    std::cout << "       --roulette fraction: Russian roulette on the emitters below this fraction of the mean emitter energy," << std::endl;
+    std::cout << "                            survivors being reweighted, then print the error against the exhaustive solution" << std::endl;
+    std::cout << "       --photon-budget count: expected photons shot per pass, raising the roulette threshold to meet it on average" << std::endl;
+    std::cout << "       --monte-carlo rays: stochastic transport shooting this many random rays per pass instead of the exhaustive one" << std::endl;
+    std::cout << "       --sampling plates|cosine: rays at uniform texels of uniform plates (default) or along cosine-weighted directions" << std::endl;
+    std::cout << "       --iterations count: stochastic transport iterations averaged progressively (default is 16)" << std::endl;
+    std::cout << "       --time-limit seconds: stop the stochastic transport iterations past this duration" << std::endl;
+    std::cout << "       --adaptive threshold: solve at the resolution first, then again subdividing the plates whose neighbouring texels differ" << std::endl;
+    std::cout << "                             by more than this step (e.g. 0.02), and print the error against the uniform finest resolution" << std::endl;
+    std::cout << "       --adaptive-levels count: subdivisions of a plate at most, every one doubling its texture width (default is 2)" << std::endl;
+    std::cout << "       --threads count: worker thread count (default is the hardware thread count)" << std::endl;
+    std::cout << "       --shards count: split the receiving plates among this many worker processes of this executable, exchanging the photons" << std::endl;
+    std::cout << "                       of every pass through a shared file mapping (same lightmaps, threads shared among the workers)" << std::endl;
+    std::cout << "       --shard-file file: photon exchange file of the sharded solve (default is in the temporary directory)" << std::endl;
+    std::cout << "       --plate-tasks: one task per plate instead of (plate, texel tile, photon chunk) tasks" << std::endl;
+    std::cout << "       --no-plate-culling: shoot every photon at every plate instead of skipping the plate pairs which cannot see each other (validation)" << std::endl;
+    std::cout << "       --grid width[,height]: depths map size in plates (default is 7,7)" << std::endl;
+    std::cout << "       --bench-generation size: time the scene generation and report the peak memory on grids growing up to this size, and exit" << std::endl;
+    std::cout << "       --bench-scaling: time the transport for 1 to 64 threads, plate tasks against tile tasks, and exit" << std::endl;
+    std::cout << "       --bench-suite file: run the micro-benchmarks and the scene, depth, resolution and thread sweeps, write them as JSON and exit" << std::endl;
+    std::cout << "       --output file: write the plates and their lightmaps to a binary lightmap file" << std::endl;
+    std::cout << "       --headless: compute without opening the viewer (with --output, on machines without display)" << std::endl;
+    std::cout << "       --load file: view a binary lightmap file instead of computing" << std::endl;
+    std::cout << "       --render-frames count: render a turntable of this many frames offscreen (EGL) to PPM files instead of viewing, and print the frame times" << std::endl;
+    std::cout << "       --render-prefix path: path prefix of the rendered frames, followed by the frame index (default is frame)" << std::endl;
+    std::cout << "       --render-size width[,height]: size of the rendered frames (default is 1600,1200)" << std::endl;
+    std::cout << "       --no-progressive: show the lightmaps once computed instead of while the passes complete them" << std::endl;
+    std::cout << "       --checkpoint file: snapshot the transport state to this file after every pass" << std::endl;
+    std::cout << "       --resume: continue from the checkpoint file when it matches the scene" << std::endl;
+    std::cout << "       --more-passes count: run this many passes on top of the resumed ones instead of the default pass count" << std::endl;
+    std::cout << "       --incremental file: relight against the state saved in this file by the previous run, then update it" << std::endl;
+    std::cout << "                           (exact transport on the visibility cache, light source by light source, no checkpoint)" << std::endl;
+    std::cout << "       --light-position x,y,z: move the light source (in plate widths)" << std::endl;
+    std::cout << "       --light-color r,g,b: change the light source color (default is 1,0.95,0.9)" << std::endl;
+    std::cout << "       --set-depth row,col,depth: change a cell of the depths map, may be repeated" << std::endl;
+    std::cout << "       --trace file: write the timings and the counters of every pass as a Chrome trace (chrome://tracing, ui.perfetto.dev)" << std::endl;
+
+    unsigned resolution{ 0 };
+    bool bruteForce{ false };
+    bool mergeOccluders{ true };
+    bool benchOccluders{ false };
+    const auto supportedKernelIsa{ DetectKernelIsa() };
+    Options options;
+    options.kernelIsa = supportedKernelIsa;
+    options.threadCount = std::max( std::thread::hardware_concurrency(), 1u );
+    bool benchKernels{ false };
+    std::size_t checkPackets{ 0 };
+    bool singlePrecision{ false };
+    bool comparePrecision{ false };
+    bool benchScaling{ false };
+    unsigned gridWidth{ 7 };
+    unsigned gridHeight{ 7 };
+    std::optional< unsigned > benchGenerationSize;
+    const char * pBenchSuitePath{ nullptr };
+    const char * pOutputPath{ nullptr };
+    bool headless{ false };
+    const char * pLoadPath{ nullptr };
+    unsigned renderFrames{ 0 };
+    std::string renderPrefix{ "frame" };
+    int renderWidth{ 1600 };
+    int renderHeight{ 1200 };
+    bool progressive{ true };
+    std::optional< Vector3D > lightPosition;
+    Vector3D lightColor{ 1, 0.95, 0.9 };
+    std::vector< std::array< int, 3 > > depthEdits;
+    Trace trace;
+    const char * pTracePath{ nullptr };
+    unsigned shardCount{ 1 };
+    const char * pShardPath{ nullptr };
+    const char * pShardWorkerPath{ nullptr };
+    unsigned shardIndex{ 0 };
+    std::optional< Real > adaptiveThreshold;
+    unsigned adaptiveLevels{ 2 };
+    const auto ParseValues{ []< typename V >( const char * _pText, std::array< V, 3 > & _values ) {
+            for( auto & value : _values ) {
+                char * pEnd{ nullptr };
+                value = static_cast< V >( std::strtod( _pText, &pEnd ) );
+                _pText = *pEnd == ',' ? pEnd + 1 : pEnd;
+            }
+        } };
+    for( int i{ 1 }; i < _argc; ++i ) {
+        const std::string_view arg{ _argv[ i ] };
+        if( arg == "--brute-force" ) {
+            bruteForce = true;
+            mergeOccluders = false; // the validation reference tests the plates themselves
+        }
+        else
+        if( arg == "--no-merge" )
+            mergeOccluders = false;
+        else
+        if( arg == "--bench-occluders" )
+            benchOccluders = true;
+        else
+        if( arg == "--cache-budget" && i + 1 < _argc )
+            options.cacheBudget = std::strtoull( _argv[ ++i ], nullptr, 10 );
+        else
+        if( arg == "--kernel" && i + 1 < _argc ) {
+            const std::string_view isa{ _argv[ ++i ] };
+            options.kernelIsa = isa == "avx512" ? KernelIsa::avx512 : ( isa == "avx2" ? KernelIsa::avx2 : KernelIsa::scalar );
+            if( options.kernelIsa > supportedKernelIsa ) {
+                std::cout << "> " << isa << " kernel is not supported, using " << KernelIsaName( supportedKernelIsa ) << std::endl;
+                options.kernelIsa = supportedKernelIsa;
+            }
+        }
+        else
+        if( arg == "--bench-kernels" )
+            benchKernels = true;
+        else
+        if( arg == "--check-packets" && i + 1 < _argc )
+            checkPackets = std::strtoull( _argv[ ++i ], nullptr, 10 );
+        else
+        if( arg == "--hierarchical" && i + 1 < _argc )
+            options.hierarchicalThreshold = std::strtod( _argv[ ++i ], nullptr );
+        else
+        if( arg == "--float" )
+            singlePrecision = true;
+        else
+        if( arg == "--compare-precision" )
+            comparePrecision = true;
+        else
+        if( arg == "--roulette" && i + 1 < _argc )
+            options.rouletteThreshold = std::strtod( _argv[ ++i ], nullptr );
+        else
+        if( arg == "--photon-budget" && i + 1 < _argc )
+            options.photonBudget = std::strtoull( _argv[ ++i ], nullptr, 10 );
+        else
+        if( arg == "--monte-carlo" && i + 1 < _argc )
+            options.monteCarloRays = std::strtoull( _argv[ ++i ], nullptr, 10 );
+        else
+        if( arg == "--adaptive" && i + 1 < _argc )
+            adaptiveThreshold = std::strtod( _argv[ ++i ], nullptr );
+        else
+        if( arg == "--adaptive-levels" && i + 1 < _argc )
+            adaptiveLevels = static_cast< unsigned >( std::strtoul( _argv[ ++i ], nullptr, 10 ) );
+        else
+        if( arg == "--sampling" && i + 1 < _argc )
+            options.raySampling = std::string_view{ _argv[ ++i ] } == "cosine" ? RaySampling::cosine : RaySampling::plates;
+        else
+        if( arg == "--iterations" && i + 1 < _argc )
+            options.monteCarloIterations = static_cast< unsigned >( std::strtoul( _argv[ ++i ], nullptr, 10 ) );
+        else
+        if( arg == "--time-limit" && i + 1 < _argc )
+            options.monteCarloSeconds = std::strtod( _argv[ ++i ], nullptr );
+        else
+        if( arg == "--threads" && i + 1 < _argc )
+            options.threadCount = std::max( static_cast< unsigned >( std::strtoul( _argv[ ++i ], nullptr, 10 ) ), 1u );
+        else
+        if( arg == "--plate-tasks" )
+            options.plateTasks = true;
+        else
+        if( arg == "--no-plate-culling" )
+            options.plateCulling = false;
+        else
+        if( arg == "--grid" && i + 1 < _argc ) {
+            char * pEnd{ nullptr };
+            gridWidth = std::max( static_cast< unsigned >( std::strtoul( _argv[ ++i ], &pEnd, 10 ) ), 1u );
+            gridHeight = *pEnd == ',' ? std::max( static_cast< unsigned >( std::strtoul( pEnd + 1, nullptr, 10 ) ), 1u ) : gridWidth;
+        }
+        else
+        if( arg == "--bench-generation" && i + 1 < _argc )
+            benchGenerationSize = static_cast< unsigned >( std::strtoul( _argv[ ++i ], nullptr, 10 ) );
+        else
+        if( arg == "--bench-scaling" )
+            benchScaling = true;
+        else
+        if( arg == "--bench-suite" && i + 1 < _argc )
+            pBenchSuitePath = _argv[ ++i ];
+        else
+        if( arg == "--output" && i + 1 < _argc )
+            pOutputPath = _argv[ ++i ];
+        else
+        if( arg == "--headless" )
+            headless = true;
+        else
+        if( arg == "--load" && i + 1 < _argc )
+            pLoadPath = _argv[ ++i ];
+        else
+        if( arg == "--render-frames" && i + 1 < _argc )
+            renderFrames = static_cast< unsigned >( std::strtoul( _argv[ ++i ], nullptr, 10 ) );
+        else
+        if( arg == "--no-progressive" )
+            progressive = false;
+        else
+        if( arg == "--render-prefix" && i + 1 < _argc )
+            renderPrefix = _argv[ ++i ];
+        else
+        if( arg == "--render-size" && i + 1 < _argc ) {
+            char * pEnd{ nullptr };
+            renderWidth = std::max( static_cast< int >( std::strtol( _argv[ ++i ], &pEnd, 10 ) ), 1 );
+            renderHeight = *pEnd == ',' ? std::max( static_cast< int >( std::strtol( pEnd + 1, nullptr, 10 ) ), 1 ) : renderWidth;
+        }
+        else
+        if( arg == "--checkpoint" && i + 1 < _argc )
+            options.pCheckpointPath = _argv[ ++i ];
+        else
+        if( arg == "--resume" )
+            options.resume = true;
+        else
+        if( arg == "--more-passes" && i + 1 < _argc )
+            options.morePasses = static_cast< unsigned >( std::strtoul( _argv[ ++i ], nullptr, 10 ) );
+        else
+        if( arg == "--incremental" && i + 1 < _argc )
+            options.pRelightPath = _argv[ ++i ];
+        else
+        if( arg == "--light-position" && i + 1 < _argc )
+            ParseValues( _argv[ ++i ], lightPosition.emplace() );
+        else
+        if( arg == "--light-color" && i + 1 < _argc )
+            ParseValues( _argv[ ++i ], lightColor );
+        else
+        if( arg == "--set-depth" && i + 1 < _argc )
+            ParseValues( _argv[ ++i ], depthEdits.emplace_back() );
+        else
+        if( arg == "--trace" && i + 1 < _argc )
+            pTracePath = _argv[ ++i ];
+        else
+        if( arg == "--shards" && i + 1 < _argc )
+            shardCount = std::max( static_cast< unsigned >( std::strtoul( _argv[ ++i ], nullptr, 10 ) ), 1u );
+        else
+        if( arg == "--shard-file" && i + 1 < _argc )
+            pShardPath = _argv[ ++i ];
+        else
+        if( arg == "--shard-worker" && i + 2 < _argc ) {
+            pShardWorkerPath = _argv[ ++i ];
+            shardIndex = static_cast< unsigned >( std::strtoul( _argv[ ++i ], nullptr, 10 ) );
+        }
+        else
+            resolution = std::atoi( _argv[ i ] );
+    }
+    const bool resolutionIsPowerOfTwo{ ( resolution > 0 ) && ( ( resolution & ( resolution - 1 ) ) == 0 ) };
+    if( resolution == 0 || !resolutionIsPowerOfTwo ) {
+        std::cout << "> no parameter, bad parameter, or parameter value is not a power of two: using default." << std::endl << std::endl;
+        resolution = defaultResolution;
+    }
+
+    if( checkPackets != 0 )
+        return CheckBlockIntersections( checkPackets, supportedKernelIsa ) == 0 ? 0 : 1;
+
+    if( pShardWorkerPath != nullptr )
+        return RunShardWorker( pShardWorkerPath, shardIndex, options, bruteForce, mergeOccluders );
+
+    // the trace is written once the viewer is closed, or right away without viewer:
+    options.pTrace = pTracePath != nullptr ? &trace : nullptr;
+    const auto WriteTrace{ [ & ]( const int _result ) {
+            if( pTracePath == nullptr )
+                return _result;
+            if( !trace.Write( pTracePath ) ) {
+                std::cerr << "Failed to write trace " << pTracePath << std::endl;
+                return -1;
+            }
+            std::cout << "trace: " << pTracePath << std::endl;
+            return _result;
+        } };
+
+    // offscreen frames instead of the viewer when asked, nothing without display:
+    const auto View{ [ & ]( const LightmapView & _lightmap, LightmapPreview * _pPreview ) {
+            Trace * const pTrace{ pTracePath != nullptr ? &trace : nullptr };
+            if( renderFrames != 0 )
+                return RenderLightmapFrames( _lightmap, renderFrames, renderPrefix, renderWidth, renderHeight, pTrace, _pPreview );
+            return headless ? 0 : ViewLightmap( _lightmap, pTrace, _pPreview );
+        } };
+
+    if( !headless && renderFrames == 0 ) {
+        std::cout << "press 'space' key to toggle between linear/nearest texture filter" << std::endl;
+        std::cout << "press 'esc' key to exit" << std::endl << std::endl;
+    }
+
+    // lightmap file, viewed in place:
+    if( pLoadPath != nullptr ) {
+        MappedFile file;
+        const auto lightmap{ file.Open( pLoadPath ) ? ViewLightmapImage( file.pData, file.size ) : std::nullopt };
+        if( !lightmap ) {
+            std::cerr << "Failed to load lightmap file " << pLoadPath << std::endl;
+            return -1;
+        }
+        std::cout << lightmap->pHeader->plateCount << " plates, resolution: " << lightmap->pHeader->textureWidth << "x" << lightmap->pHeader->textureWidth << std::endl;
+        return WriteTrace( View( *lightmap, nullptr ) );
+    }
+
+    const Scene scene{
+        gridWidth, gridHeight, // scene dimensions
+        2, // scene depth
+        25, // depth rate
+        30, // color rate
+        1, // plate width
+        resolution, // texture width
+        0.5, // material energy retransmission ratio
+        10, // wavelength decay distance
+        { 0.8, 0.9, 1 }, // wavelength decay
+        4, 20, // depths map and plate colors seeds
+    };
+
+    static constexpr unsigned maxRenderingPass{ 4 }; // maximum rendering pass
+
+    if( benchGenerationSize )
+        return BenchGeneration( scene, *benchGenerationSize );
+
+    // generate depths map, edited, and related plates:
+    auto depthsMap{ GenerateDepthsMap( scene ) };
+    for( const auto & [ row, col, depth ] : depthEdits ) {
+        if( row < 0 || col < 0 || static_cast< unsigned >( row ) >= scene.height || static_cast< unsigned >( col ) >= scene.width ) {
+            std::cerr << "Depths map cell " << row << "," << col << " is out of the scene" << std::endl;
+            return -1;
+        }
+        depthsMap( static_cast< unsigned >( row ), static_cast< unsigned >( col ) ) = depth;
+    }
+    auto plates{ GeneratePlates( scene, depthsMap ) };
+
+    std::cout << plates.size() << " plates, resolution: " << scene.textureWidth << "x" << scene.textureWidth << std::endl;
+    std::cout << "material light retransmission rate: " << static_cast< int >( scene.materialRetransmission * 100 ) << "%" << std::endl;
+    std::cout << "occlusion test: " << ( bruteForce ? "brute force" : "bounding volume hierarchy" ) << std::endl;
+    std::cout << "transport kernel: " << KernelIsaName( options.kernelIsa ) << ", " << ( singlePrecision ? "single" : "double" ) << " precision" << std::endl;
+    std::cout << "scheduler: " << options.threadCount << " thread(s), " << ( options.plateTasks ? "plate" : "tile" ) << " tasks" << std::endl;
+    if( options.hierarchicalThreshold )
+        std::cout << "hierarchical emitters, refinement threshold: " << *options.hierarchicalThreshold << std::endl;
+
+    // the relighting runs the exhaustive transport on its visibility cache, the stochastic transport keeps no checkpoint:
+    if( options.monteCarloRays != 0 && options.pRelightPath != nullptr ) {
+        std::cout << "> the incremental relighting runs the exhaustive transport: ignoring the stochastic transport" << std::endl;
+        options.monteCarloRays = 0;
+    }
+    if( options.monteCarloRays != 0 && options.pCheckpointPath != nullptr ) {
+        std::cout << "> the stochastic transport writes and resumes no checkpoint: ignoring the checkpoint" << std::endl;
+        options.pCheckpointPath = nullptr;
+        options.resume = false;
+    }
+
+    // the adaptive resolution solves twice, exhaustively, in one process, its plates of several widths shown in tiles of the finest one:
+    if( adaptiveThreshold && ( options.rouletteThreshold || options.photonBudget != 0 || options.pCheckpointPath != nullptr || options.pRelightPath != nullptr
+        || options.monteCarloRays != 0 || shardCount > 1 || comparePrecision ) ) {
+        std::cout << "> the adaptive resolution runs the exhaustive transport in a single process, without roulette, checkpoint, relighting nor precision comparison:"
+                  << " using the uniform resolution" << std::endl;
+        adaptiveThreshold.reset();
+    }
+    const auto tileWidth{ adaptiveThreshold ? scene.textureWidth << adaptiveLevels : scene.textureWidth };
+    if( adaptiveThreshold )
+        std::cout << "adaptive resolution: " << scene.textureWidth << "x" << scene.textureWidth << " to " << tileWidth << "x" << tileWidth
+                  << ", subdivision threshold: " << *adaptiveThreshold << std::endl;
+
+    // the worker processes of the sharded solve are started with the same arguments, sharing the threads:
+    if( shardCount > 1 && ( options.rouletteThreshold || options.photonBudget != 0 || options.pCheckpointPath != nullptr || options.pRelightPath != nullptr || options.monteCarloRays != 0 ) ) {
+        std::cout << "> the sharded solve runs the exhaustive transport only, without roulette, checkpoint nor relighting: using a single process" << std::endl;
+        shardCount = 1;
+    }
+    shardCount = std::min( shardCount, static_cast< unsigned >( plates.size() ) );
+    std::vector< std::string > workerArguments( _argv, _argv + _argc );
+    workerArguments.insert( workerArguments.end(), { "--threads", std::to_string( std::max( options.threadCount / shardCount, 1u ) ) } );
+    if( shardCount > 1 )
+        std::cout << "sharded solve: " << shardCount << " worker process(es), " << std::max( options.threadCount / shardCount, 1u ) << " thread(s) each" << std::endl;
+
+    // merge the coplanar plates into occluders and build occlusion acceleration structure once, plates never move afterwards:
+    std::vector< unsigned > plateOccluders;
+    const auto occluders{ mergeOccluders ? MergeOccluders( plates, plateOccluders ) : PlateQuads( plates ) };
+    std::cout << "occluders: " << occluders.size() << ( mergeOccluders ? " (coplanar plates merged)" : " (plates)" ) << std::endl;
+    const auto occlusionTree{ BuildOcclusionTree( occluders ) };
+    const Occlusion occlusion{ occluders, occlusionTree, bruteForce, options.kernelIsa == KernelIsa::scalar ? nullptr : SelectBlockIntersection( options.kernelIsa ),
+        mergeOccluders ? &plateOccluders : nullptr };
+
+    // light sources:
+    const std::vector< Photon< Real > > lightSources{
+        { lightPosition.value_or( Vector3D{ 1.01, 3.23, -2.34 } ), { 0, 0, 1 }, VecMult( lightColor, Real{ 0.2 } / Real{ maxRenderingPass } ) }
+    };
+
+    if( benchKernels ) {
+        const auto Bench{ [ & ]< typename T, unsigned TextureWidth >() { BenchKernels< T, TextureWidth >( scene, plates, lightSources, supportedKernelIsa ); } };
+        std::cout << "double precision:" << std::endl;
+        DispatchTextureWidth< double >( scene.textureWidth, Bench );
+        std::cout << "single precision:" << std::endl;
+        DispatchTextureWidth< float >( scene.textureWidth, Bench );
+        return 0;
+    }
+
+    if( pBenchSuitePath != nullptr )
+        return BenchSuite( pBenchSuitePath, scene, lightSources, maxRenderingPass, options, singlePrecision, bruteForce, mergeOccluders );
+
+    if( benchOccluders )
+        return BenchOccluders( scene, lightSources, options, singlePrecision, bruteForce );
+
+    // the engine is selected once, for the precision and the texture width:
+    const auto Run{ [ & ]< typename T, unsigned TextureWidth >() {
+            if( options.pRelightPath != nullptr )
+                return SolveIncremental< T, TextureWidth >( scene, plates, occlusion, lightSources, maxRenderingPass, options );
+            if( shardCount > 1 )
+                return SolveSharded< T >( scene, plates, lightSources, maxRenderingPass, options, shardCount, workerArguments, pShardPath );
+            if( adaptiveThreshold )
+                return SolveAdaptive< T, TextureWidth >( scene, plates, occlusion, lightSources, maxRenderingPass, options, *adaptiveThreshold, adaptiveLevels );
+            return options.monteCarloRays != 0 ? SolveMonteCarlo< T, TextureWidth >( scene, plates, occlusion, lightSources, maxRenderingPass, options )
+                                               : Solve< T, TextureWidth >( scene, plates, occlusion, lightSources, maxRenderingPass, options );
+        } };
+
+    // core scaling of both task decompositions, the solve being otherwise the one configured by the options:
+    if( benchScaling ) {
+        options.verbose = false;
+        std::array< double, 2 > singleThreadDurations{ 0, 0 };
+        for( unsigned threadCount{ 1 }; threadCount <= 64; threadCount *= 2 ) {
+            std::cout << threadCount << " thread(s):";
+            for( const bool plateTasks : { true, false } ) {
+                options.threadCount = threadCount;
+                options.plateTasks = plateTasks;
+                const auto tBench{ std::chrono::high_resolution_clock::now() };
+                singlePrecision ? DispatchTextureWidth< float >( scene.textureWidth, Run ) : DispatchTextureWidth< double >( scene.textureWidth, Run );
+                const auto benchDuration{ std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tBench ).count() };
+                auto & singleThreadDuration{ singleThreadDurations[ plateTasks ? 0 : 1 ] };
+                if( threadCount == 1 )
+                    singleThreadDuration = benchDuration;
+                std::cout << ( plateTasks ? " plate tasks " : ", tile tasks " ) << benchDuration << "s (x" << singleThreadDuration / benchDuration << ")";
+            }
+            std::cout << std::endl;
+        }
+        return 0;
+    }
+
+    // with a viewer, the lightmap tiles are published to it as the passes complete them, the transport running on its own thread,
+    // unless the whole computation is waited for:
+    const bool viewing{ !headless || renderFrames != 0 };
+    std::optional< LightmapPreview > preview;
+    if( viewing )
+        preview.emplace( plates.size(), tileWidth );
+    options.pPreview = viewing && progressive ? &*preview : nullptr;
+
+    // transport, error reports and lightmap file, false when the file cannot be created:
+    Lightmaps lightmaps;
+    std::vector< Color > colors;
+    auto fileHeader{ LightmapFileLayout( scene, tileWidth, UniformAtlasOffsets( plates.size(), std::size_t{ tileWidth } * tileWidth ) ) };
+    const auto Compute{ [ & ]{
+        const auto t0{ std::chrono::high_resolution_clock::now() };
+
+        lightmaps = singlePrecision || comparePrecision ? DispatchTextureWidth< float >( scene.textureWidth, Run ) : DispatchTextureWidth< double >( scene.textureWidth, Run );
+        if( lightmaps.size() != plates.size() )
+            return false; // sharded solve failure, reported already
+        fileHeader = LightmapFileLayout( scene, tileWidth, lightmaps.offsets );
+
+        // computation duration:
+        const auto duration{ std::chrono::high_resolution_clock::now() - t0 };
+        const auto minutes { std::chrono::duration_cast< std::chrono::minutes >( duration ) };
+        const auto seconds { std::chrono::duration_cast< std::chrono::seconds >( duration - minutes ) };
+        const auto milliseconds { std::chrono::duration_cast< std::chrono::milliseconds >( duration - minutes - seconds ) };
+        std::cout << "computation duration: " << minutes.count() << "m " << seconds.count() << "s " << milliseconds.count() << "ms" << std::endl;
+        std::cout << "peak resident memory: " << PeakResidentMegabytes() << "MB" << std::endl;
+
+        // the comparison runs below are not shown:
+        options.pPreview = nullptr;
+
+        // single precision error, against the double precision reference, leaving the checkpoint, the relighting state and the trace
+        // to the single precision run:
+        if( comparePrecision ) {
+            options.verbose = false;
+            options.pCheckpointPath = nullptr;
+            options.resume = false;
+            options.pRelightPath = nullptr;
+            options.pTrace = nullptr;
+            CompareLightmaps( "single vs double precision", lightmaps, DispatchTextureWidth< double >( scene.textureWidth, Run ) );
+        }
+
+        // roulette error, against the exhaustive solution (every emitter shot at its full energy) computed from scratch,
+        // leaving the checkpoint, the relighting state and the trace to the roulette run:
+        if( options.rouletteThreshold.has_value() || options.photonBudget != 0 ) {
+            options.rouletteThreshold = std::nullopt;
+            options.photonBudget = 0;
+            options.verbose = false;
+            options.pCheckpointPath = nullptr;
+            options.resume = false;
+            options.pRelightPath = nullptr;
+            options.pTrace = nullptr;
+            const auto tExhaustive{ std::chrono::high_resolution_clock::now() };
+            const auto exhaustive{ singlePrecision ? DispatchTextureWidth< float >( scene.textureWidth, Run ) : DispatchTextureWidth< double >( scene.textureWidth, Run ) };
+            const auto exhaustiveDuration{ std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tExhaustive ).count() };
+            std::cout << "exhaustive duration: " << exhaustiveDuration << "s, roulette duration: " << std::chrono::duration< double >( duration ).count() << "s" << std::endl;
+            CompareLightmaps( "roulette vs exhaustive", lightmaps, exhaustive );
+        }
+
+        // adaptive error, against the uniform solve at the finest width computed from scratch, the adaptive lightmaps being resampled to it:
+        if( adaptiveThreshold ) {
+            options.verbose = false;
+            options.pTrace = nullptr;
+            Scene uniformScene{ scene };
+            uniformScene.textureWidth = tileWidth;
+            const auto RunUniform{ [ & ]< typename T, unsigned TextureWidth >() {
+                    return Solve< T, TextureWidth >( uniformScene, plates, occlusion, lightSources, maxRenderingPass, options );
+                } };
+            const auto tUniform{ std::chrono::high_resolution_clock::now() };
+            const auto uniform{ singlePrecision ? DispatchTextureWidth< float >( tileWidth, RunUniform ) : DispatchTextureWidth< double >( tileWidth, RunUniform ) };
+            const auto uniformDuration{ std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - tUniform ).count() };
+            std::cout << "uniform duration: " << uniformDuration << "s, " << uniform.offsets.back() << " texel(s), adaptive duration: "
+                      << std::chrono::duration< double >( duration ).count() << "s, " << lightmaps.offsets.back() << " texel(s)" << std::endl;
+            CompareLightmaps( "adaptive vs uniform", ResampleLightmaps( lightmaps, tileWidth ), uniform );
+        }
+
+        // convert received power values as RGB texture, the viewer being shown the final tiles as well:
+        colors = [ & ]{
+                ScopedTimer textureTimer{ pTracePath != nullptr ? &trace : nullptr, "texture conversion" };
+                return AtlasColors( MakeTextureAtlas( plates.size(), tileWidth ), lightmaps );
+            }();
+        if( preview )
+            preview->Publish( lightmaps );
+
+        // lightmap file, written in place through its mapping:
+        if( pOutputPath != nullptr ) {
+            MappedFile file;
+            if( !file.Create( pOutputPath, fileHeader.fileSize ) ) {
+                std::cerr << "Failed to create lightmap file " << pOutputPath << std::endl;
+                return false;
+            }
+            WriteLightmapImage( file.pData, fileHeader, plates, lightmaps, colors );
+            std::cout << "lightmap file: " << pOutputPath << ", " << fileHeader.fileSize / 1024 << "KB" << std::endl;
+        }
+        return true;
+    } };
+
+    if( !viewing )
+        return Compute() ? WriteTrace( 0 ) : -1;
+
+    // the viewer starts on the plates alone, black, while the transport fills their tiles in, never waiting for the viewer:
+    if( progressive ) {
+        std::vector< std::byte > image( fileHeader.fileSize );
+        WriteLightmapImage( image.data(), fileHeader, plates, Lightmaps{ plates.size(), std::size_t{ tileWidth } * tileWidth },
+            std::vector< Color >( std::size_t{ fileHeader.atlasWidth } * fileHeader.atlasHeight, Color{ 0, 0, 0 } ) );
+        bool computed{ false };
+        std::thread computation{ [ & ]{
+                computed = Compute();
+                preview->complete.store( true, std::memory_order_release );
+            } };
+        const auto viewResult{ View( *ViewLightmapImage( image.data(), image.size() ), &*preview ) };
+        if( !preview->complete.load( std::memory_order_acquire ) )
+            std::cout << "waiting for the transport to complete" << std::endl;
+        computation.join();
+        std::cout << "preview: " << preview->publishedCount.load() << " tile(s) published, " << preview->uploadedCount << " uploaded" << std::endl;
+        return computed ? WriteTrace( viewResult ) : -1;
+    }
+
+    if( !Compute() )
+        return -1;
+    preview->complete.store( true, std::memory_order_release );
+    std::vector< std::byte > image( fileHeader.fileSize );
+    WriteLightmapImage( image.data(), fileHeader, plates, lightmaps, colors );
+    return WriteTrace( View( *ViewLightmapImage( image.data(), image.size() ), &*preview ) );
+}